@@ -0,0 +1,488 @@
+#include "Board.h"
+#include "Engine.h"
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+/*
+Microbenchmarks for the board primitives.
+
+Every benchmark runs over the same fixed corpus of positions so that two runs
+(or two commits) can be compared. Each benchmark is run once to warm up and then
+`repeats` times, the fastest run is kept. A run loops over the corpus for at
+least minRunDuration.
+
+--audit runs perft and a search over the corpus once to warm up, then again while
+counting the allocations, and fails if there are any : the search and the move
+generation only use what the board and the engine allocated beforehand.
+
+usage : bench [--repeats N] [--filter name] [--json file] [--audit]
+*/
+
+
+// every allocation made by the process goes through here so the benchmarks
+// can report how many allocations one operation costs. All the forms are replaced
+// together so that every block is freed by the same allocator that made it
+static atomic<unsigned long long> allocationCount{ 0 };
+
+static void* countedAllocation(size_t size)
+{
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr) {
+		throw bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new(size_t size) {
+	return countedAllocation(size);
+}
+
+void* operator new[](size_t size) {
+	return countedAllocation(size);
+}
+
+void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+
+// keeps the compiler from optimizing the benchmarked calls away
+static volatile U64 sink;
+
+static const chrono::milliseconds minRunDuration = chrono::milliseconds(20);
+static const int perftDepth = 2;
+static const int searchDepth = 3;
+
+
+static const vector<string> corpus = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"rnbqkbnr/pppppppp/8/3p1p2/4B3/3p4/PPPPPPPp/RNBQKBNR w KQkq - 0 1",
+	"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+
+struct BenchResult {
+	string name;
+	unsigned long long ops;
+	double nsPerOp;
+	double allocsPerOp;
+};
+
+struct PlacedPiece {
+	Vector2Int square;
+	char piece;
+};
+
+
+class BoardBench {
+private:
+	Board board;
+	vector<BoardState> positions;
+	// copies of the positions the benchmarks are allowed to modify
+	vector<BoardState> scratchPositions;
+	// per position, every piece on the board and every legal move of the side to move
+	vector<vector<PlacedPiece>> placedPieces;
+	vector<vector<Move>> legalMoves;
+
+	int repeats;
+	string filter;
+	vector<BenchResult> results;
+	// summed over every search run, to see which move ordering stage does the work
+	unsigned long long searchCutoffs[PICKER_STAGES];
+	// for the movePicker benchmark
+	PickerBuffer pickerBuffer;
+	int quietHistory[64][64];
+
+	// body runs the benchmark once over the whole corpus and returns the number of operations done
+	template <typename Body>
+	void run(string name, Body body) {
+		if (!filter.empty() && name.find(filter) == string::npos) {
+			return;
+		}
+
+		body(); // warm up
+
+		BenchResult best = BenchResult{ name, 0, 0.0, 0.0 };
+		for (int i = 0; i < repeats; i++) {
+			unsigned long long allocationsBefore = allocationCount.load(memory_order_relaxed);
+			auto start = chrono::steady_clock::now();
+			auto end = start;
+			unsigned long long ops = 0;
+			// the corpus is small, go over it again until the run is long enough to time
+			do {
+				ops += body();
+				end = chrono::steady_clock::now();
+			} while (end - start < minRunDuration);
+			unsigned long long allocations = allocationCount.load(memory_order_relaxed) - allocationsBefore;
+
+			double ns = double(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+			double nsPerOp = ops ? ns / double(ops) : 0.0;
+			if (i == 0 || nsPerOp < best.nsPerOp) {
+				best.ops = ops;
+				best.nsPerOp = nsPerOp;
+				best.allocsPerOp = ops ? double(allocations) / double(ops) : 0.0;
+			}
+		}
+
+		cout << left << setw(28) << best.name
+			<< right << setw(14) << fixed << setprecision(1) << best.nsPerOp << " ns/op"
+			<< setw(12) << setprecision(2) << best.allocsPerOp << " allocs/op"
+			<< setw(10) << best.ops << " ops" << endl;
+		results.push_back(best);
+	}
+
+	// times one of the per-piece generators on every matching piece of the corpus
+	template <typename Generator>
+	void runGenerator(string name, char pieceType, Generator generator) {
+		run(name, [&]() {
+			unsigned long long ops = 0;
+			for (size_t i = 0; i < positions.size(); i++) {
+				for (const PlacedPiece& placed : placedPieces[i]) {
+					if (tolower(placed.piece) == pieceType) {
+						sink = sink ^ generator(placed, positions[i]);
+						ops++;
+					}
+				}
+			}
+			return ops;
+		});
+	}
+
+public:
+	BoardBench(int newRepeats, string newFilter)
+		: board(corpus[0]) {
+		repeats = newRepeats;
+		filter = newFilter;
+		fill(searchCutoffs, searchCutoffs + PICKER_STAGES, 0ull);
+		fill(&quietHistory[0][0], &quietHistory[0][0] + 64 * 64, 0);
+
+		for (const string& FEN : corpus) {
+			BoardState position = board.ReadFEN(FEN);
+			positions.push_back(position);
+
+			vector<PlacedPiece> pieces;
+			for (char piece : Board::pieces) {
+				for (Vector2Int square : board.getAllPosInBitBoard(position.piecesBitmaps[piece])) {
+					pieces.push_back(PlacedPiece{ square, piece });
+				}
+			}
+			placedPieces.push_back(pieces);
+			legalMoves.push_back(board.getLegalMoves(position));
+		}
+		scratchPositions = positions;
+	}
+
+	void runAll() {
+		run("ReadFEN", [&]() {
+			unsigned long long ops = 0;
+			for (const string& FEN : corpus) {
+				BoardState position = board.ReadFEN(FEN);
+				sink = sink ^ position.turn;
+				ops++;
+			}
+			return ops;
+		});
+
+		run("whatIsOnSquare", [&]() {
+			unsigned long long ops = 0;
+			for (const BoardState& position : positions) {
+				for (int y = 0; y < 8; y++) {
+					for (int x = 0; x < 8; x++) {
+						sink = sink ^ board.whatIsOnSquare(Vector2Int{ x, y }, position);
+						ops++;
+					}
+				}
+			}
+			return ops;
+		});
+
+		runGenerator("getValidMovesBitBoardRook", 'r', [&](const PlacedPiece& placed, const BoardState& position) {
+			return board.getValidMovesBitBoardRook(placed.square, position);
+		});
+		runGenerator("getValidMovesBitBoardBishop", 'b', [&](const PlacedPiece& placed, const BoardState& position) {
+			return board.getValidMovesBitBoardBishop(placed.square, position);
+		});
+		runGenerator("getValidMovesBitBoardKnight", 'n', [&](const PlacedPiece& placed, const BoardState& position) {
+			return board.getValidMovesBitBoardKnight(placed.square, position);
+		});
+		runGenerator("getValidMovesBitBoardPawn", 'p', [&](const PlacedPiece& placed, const BoardState& position) {
+			return board.getValidMovesBitBoardPawn(placed.square, isupper(placed.piece), position);
+		});
+		runGenerator("getValidMovesBitBoardKing", 'k', [&](const PlacedPiece& placed, const BoardState& position) {
+			return board.getValidMovesBitBoardKing(placed.square, position);
+		});
+
+		run("getAttackedSquaresBy", [&]() {
+			unsigned long long ops = 0;
+			for (const BoardState& position : positions) {
+				sink = sink ^ board.getAttackedSquaresBy(true, position);
+				sink = sink ^ board.getAttackedSquaresBy(false, position);
+				ops += 2;
+			}
+			return ops;
+		});
+
+		// checkers, pins and both attack maps of one position
+		run("updateAttackInfo", [&]() {
+			unsigned long long ops = 0;
+			for (BoardState& position : scratchPositions) {
+				position.attackInfoValid = false;
+				board.updateAttackInfo(position);
+				sink = sink ^ position.attackedBy[White];
+				ops++;
+			}
+			return ops;
+		});
+
+		// one operation is every legal move of the side to move in one position. The positions
+		// are copied so that each call computes the attack information again
+		run("legalMoves", [&]() {
+			unsigned long long ops = 0;
+			for (BoardState position : positions) {
+				sink = sink ^ board.getLegalMoves(position).size();
+				ops++;
+			}
+			return ops;
+		});
+
+		// mate, stalemate, 50 moves and repetitions in one position
+		run("getGameStatus", [&]() {
+			unsigned long long ops = 0;
+			PositionHistory history = PositionHistory{};
+			for (BoardState position : positions) {
+				history.count = 0;
+				pushHistory(history, position.hash);
+				sink = sink ^ board.getGameStatus(position, history);
+				ops++;
+			}
+			return ops;
+		});
+
+		// the board is copy-make : making a move returns a new state and
+		// unmaking it is going back to the previous one
+		run("makeUnmake", [&]() {
+			unsigned long long ops = 0;
+			for (size_t i = 0; i < positions.size(); i++) {
+				for (const Move& move : legalMoves[i]) {
+					BoardState next = board.movePiece(move.from, move.to, positions[i]);
+					sink = sink ^ next.enPassant.x;
+					ops++;
+				}
+			}
+			return ops;
+		});
+
+		// one operation is every move of one position picked, with the first legal moves given
+		// as hash move, killers and counter move so that each of them is checked for legality
+		run("movePicker", [&]() {
+			return pickAllMoves();
+		});
+		printAttackInfoComputations();
+
+		// one operation is one leaf node, ns/op is the inverse of the perft nodes per second
+		run("perft", [&]() {
+			unsigned long long ops = 0;
+			for (const BoardState& position : positions) {
+				ops += board.perft(position, perftDepth);
+			}
+			return ops;
+		});
+
+		// one operation is one node of a fixed depth search, a new engine each time so
+		// the runs don't reuse the move ordering of the previous one
+		run("search", [&]() {
+			unsigned long long ops = 0;
+			EngineConfig config = defaultEngineConfig();
+			config.maxDepth = searchDepth;
+			for (const BoardState& position : positions) {
+				Engine engine = Engine(config);
+				SearchResult result = engine.search(position);
+				for (int stage = 0; stage < PICKER_STAGES; stage++) {
+					searchCutoffs[stage] += result.cutoffs[stage];
+				}
+				ops += result.nodes;
+			}
+			return ops;
+		});
+		printCutoffs();
+	}
+
+	// false if perft or the search allocated once warmed up
+	bool auditAllocations() {
+		EngineConfig config = defaultEngineConfig();
+		config.maxDepth = searchDepth + 1;
+		// one engine per position, created before counting
+		vector<unique_ptr<Engine>> engines;
+		for (size_t i = 0; i < positions.size(); i++) {
+			engines.push_back(make_unique<Engine>(config));
+		}
+
+		auto perftAll = [&]() {
+			unsigned long long nodes = 0;
+			for (const BoardState& position : positions) {
+				nodes += board.perft(position, perftDepth + 1);
+			}
+			return nodes;
+		};
+		auto searchAll = [&]() {
+			unsigned long long nodes = 0;
+			for (size_t i = 0; i < positions.size(); i++) {
+				nodes += engines[i]->search(positions[i]).nodes;
+			}
+			return nodes;
+		};
+
+		perftAll();
+		searchAll();
+
+		unsigned long long before = allocationCount.load(memory_order_relaxed);
+		unsigned long long perftNodes = perftAll();
+		unsigned long long perftAllocations = allocationCount.load(memory_order_relaxed) - before;
+
+		before = allocationCount.load(memory_order_relaxed);
+		unsigned long long searchNodes = searchAll();
+		unsigned long long searchAllocations = allocationCount.load(memory_order_relaxed) - before;
+
+		cout << "perft  " << setw(10) << perftNodes << " nodes " << setw(8) << perftAllocations << " allocations" << endl;
+		cout << "search " << setw(10) << searchNodes << " nodes " << setw(8) << searchAllocations << " allocations" << endl;
+		if (perftAllocations || searchAllocations) {
+			cout << "FAILED : the hot path allocates" << endl;
+			return false;
+		}
+		cout << "ok : no allocation after the warm up" << endl;
+		return true;
+	}
+
+	// picks every move of every position of the corpus, returns the number of positions
+	unsigned long long pickAllMoves() {
+		for (size_t i = 0; i < positions.size(); i++) {
+			const vector<Move>& moves = legalMoves[i];
+			auto nthMove = [&](size_t n) { return n < moves.size() ? moves[n] : noMove; };
+			BoardState position = positions[i];
+			MovePicker picker = MovePicker(board, pickerBuffer, position, nthMove(0), nthMove(1), nthMove(2), nthMove(3),
+				quietHistory);
+			Move move;
+			while (picker.next(move)) {
+				sink = sink ^ move.to.x;
+			}
+		}
+		return positions.size();
+	}
+
+	// the picker keeps the attack information in the position it was given, one computation
+	// per position covers the hash move, the killers and both generation stages
+	void printAttackInfoComputations() {
+		if (!filter.empty() && string("movePicker").find(filter) == string::npos) {
+			return;
+		}
+		unsigned long long before = board.attackInfoComputations;
+		unsigned long long pickedPositions = pickAllMoves();
+		cout << "  attack info computed " << fixed << setprecision(2)
+			<< double(board.attackInfoComputations - before) / double(pickedPositions) << " times per position" << endl;
+	}
+
+	void printCutoffs() {
+		unsigned long long total = 0;
+		for (int stage = 0; stage < PICKER_STAGES; stage++) {
+			total += searchCutoffs[stage];
+		}
+		if (!total) {
+			return;
+		}
+
+		const string stageNames[PICKER_STAGES] = { "hash", "captures", "killers", "bad captures", "quiets" };
+		cout << "  cutoffs by stage :";
+		for (int stage = 0; stage < PICKER_STAGES; stage++) {
+			cout << " " << stageNames[stage] << " " << fixed << setprecision(1)
+				<< 100.0 * double(searchCutoffs[stage]) / double(total) << "%";
+		}
+		cout << endl;
+	}
+
+	// flat JSON so two runs can be diffed line by line
+	void writeJSON(string path) {
+		ofstream file(path);
+		file << "{\n";
+		file << "  \"positions\": " << positions.size() << ",\n";
+		file << "  \"repeats\": " << repeats << ",\n";
+		file << "  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			file << "    { \"name\": \"" << results[i].name << "\""
+				<< ", \"ops\": " << results[i].ops
+				<< fixed << setprecision(2)
+				<< ", \"ns_per_op\": " << results[i].nsPerOp
+				<< ", \"allocs_per_op\": " << results[i].allocsPerOp
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n";
+		file << "}\n";
+	}
+};
+
+
+int main(int argc, char** argv)
+{
+	int repeats = 10;
+	string filter = "";
+	string JSONPath = "";
+	bool audit = false;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--repeats" && i + 1 < argc) {
+			repeats = max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		}
+		else if (arg == "--json" && i + 1 < argc) {
+			JSONPath = argv[++i];
+		}
+		else if (arg == "--audit") {
+			audit = true;
+		}
+		else {
+			cout << "usage : bench [--repeats N] [--filter name] [--json file] [--audit]" << endl;
+			return 1;
+		}
+	}
+
+	BoardBench bench = BoardBench(repeats, filter);
+	if (audit) {
+		return bench.auditAllocations() ? 0 : 1;
+	}
+	bench.runAll();
+
+	if (!JSONPath.empty()) {
+		bench.writeJSON(JSONPath);
+		cout << "results written to " << JSONPath << endl;
+	}
+
+	return 0;
+}
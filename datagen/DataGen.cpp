@@ -0,0 +1,278 @@
+#include "Board.h"
+#include "Engine.h"
+#include "TrainingData.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Plays fixed node self-play games on every core and writes the quiet positions with their
+search score and the result of the game, as training data for the evaluation weights
+(see TrainingData.h).
+
+Each game starts with a few random moves so that no two games are the same. The random
+moves are not recorded, and neither are the positions in check or where the best move
+is a capture or a promotion : their score depends on what happens next more than on
+the position.
+
+usage : datagen [--games N] [--threads N] [--nodes N] [--randomplies N] [--maxplies N]
+                [--output prefix] [--shardsize records] [--seed N]
+*/
+
+
+static const string startingFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+typedef struct DataGenSettings {
+	int games;
+	int threads;
+	unsigned long long nodes;
+	int randomPlies;
+	int maxPlies;
+	string output;
+	size_t shardSize;
+	unsigned int seed;
+
+	// the game is adjudicated once the search sees this much for resignPlies plies in a row
+	int resignScore;
+	int resignPlies;
+} DataGenSettings;
+
+
+static bool onlyKingsLeft(BoardState position)
+{
+	for (auto& [piece, bitBoard] : position.piecesBitmaps) {
+		if (bitBoard && piece != 'K' && piece != 'k') {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool isPromotion(Move move, BoardState& position)
+{
+	char piece = position.mailbox[move.from.x + move.from.y * 8];
+	return (piece == 'P' && move.to.y == 0) || (piece == 'p' && move.to.y == 7);
+}
+
+
+class DataGenerator {
+private:
+	DataGenSettings settings;
+
+	atomic<int> nextGame;
+	atomic<unsigned long long> gamesPlayed;
+	atomic<unsigned long long> positionsWritten;
+	atomic<int> shards;
+	atomic<bool> failed;
+
+	// plays random moves from the starting position, false if the game ended on the way
+	bool playOpening(Board& rules, mt19937& random, BoardState& position, PositionHistory& history) {
+		position = rules.getState();
+		history.count = 0;
+		pushHistory(history, position.hash);
+		// an odd number of plies half of the time, so that both sides get to start
+		int plies = settings.randomPlies + random() % 2;
+		for (int ply = 0; ply < plies; ply++) {
+			vector<Move> moves = rules.getLegalMoves(position);
+			if (moves.empty()) {
+				return false;
+			}
+			position = rules.makeMove(moves[random() % moves.size()], position);
+			pushHistory(history, position.hash);
+		}
+		return rules.hasLegalMove(position);
+	}
+
+	// the result from the point of view of white
+	int playGame(Board& rules, Engine& engine, BoardState position, PositionHistory& history, vector<TrainingRecord>& records) {
+		int resignStreak = 0; // > 0 when white is winning, < 0 when black is
+
+		for (int ply = 0; ply < settings.maxPlies; ply++) {
+			GameStatus status = rules.getGameStatus(position, history);
+			if (status == Checkmate) {
+				return position.WToMove ? -1 : 1;
+			}
+			if (status != Ongoing || onlyKingsLeft(position)) {
+				return 0;
+			}
+
+			SearchResult result = engine.search(position, history);
+
+			// mate scores say nothing about the evaluation
+			bool quiet = !rules.isInCheck(position) && !rules.isCapture(result.bestMove, position)
+				&& !isPromotion(result.bestMove, position) && abs(result.score) < MATE_SCORE - MAX_PLY;
+			if (quiet) {
+				TrainingRecord record = TrainingRecord{};
+				record.position = rules.packPosition(position);
+				record.score = int16_t(clamp(result.score, -32000, 32000));
+				// the result is only known at the end, white wins for now
+				record.result = position.WToMove ? 1 : -1;
+				records.push_back(record);
+			}
+
+			int whiteScore = position.WToMove ? result.score : -result.score;
+			if (whiteScore >= settings.resignScore) {
+				resignStreak = max(resignStreak, 0) + 1;
+			}
+			else if (whiteScore <= -settings.resignScore) {
+				resignStreak = min(resignStreak, 0) - 1;
+			}
+			else {
+				resignStreak = 0;
+			}
+			if (abs(resignStreak) >= settings.resignPlies) {
+				return resignStreak > 0 ? 1 : -1;
+			}
+
+			position = rules.makeMove(result.bestMove, position);
+			pushHistory(history, position.hash);
+		}
+		return 0;
+	}
+
+	void worker(int threadIndex) {
+		Board rules = Board(startingFEN);
+		EngineConfig config = defaultEngineConfig();
+		config.maxDepth = MAX_PLY - 1;
+		config.maxNodes = settings.nodes;
+		Engine engine = Engine(config);
+		mt19937 random(settings.seed + threadIndex);
+		ShardWriter writer = ShardWriter(settings.output, threadIndex, settings.shardSize, 4096);
+
+		vector<TrainingRecord> records;
+		PositionHistory history;
+		while (!failed) {
+			int game = nextGame++;
+			if (game >= settings.games) {
+				break;
+			}
+
+			BoardState position;
+			while (!playOpening(rules, random, position, history)) {
+			}
+
+			records.clear();
+			int whiteResult = playGame(rules, engine, position, history, records);
+			for (TrainingRecord& record : records) {
+				// result was 1 for the white positions and -1 for the black ones
+				record.result = int8_t(record.result * whiteResult);
+				writer.write(record);
+			}
+
+			gamesPlayed.fetch_add(1, memory_order_relaxed);
+			positionsWritten.fetch_add(records.size(), memory_order_relaxed);
+			if (!writer.isGood()) {
+				failed = true;
+			}
+		}
+
+		writer.close();
+		shards += writer.getShardCount();
+		if (!writer.isGood()) {
+			failed = true;
+		}
+	}
+
+public:
+	DataGenerator(DataGenSettings newSettings) {
+		settings = newSettings;
+		nextGame = 0;
+		gamesPlayed = 0;
+		positionsWritten = 0;
+		shards = 0;
+		failed = false;
+	}
+
+	// false if a shard could not be written
+	bool run() {
+		auto start = chrono::steady_clock::now();
+		vector<thread> workers;
+		for (int i = 0; i < settings.threads; i++) {
+			workers.push_back(thread(&DataGenerator::worker, this, i));
+		}
+
+		// progress every 10 seconds, the workers never wait for it
+		atomic<bool> done = false;
+		thread reporter([&]() {
+			int reports = 0;
+			while (!done) {
+				this_thread::sleep_for(chrono::milliseconds(100));
+				double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+				if (!done && seconds >= (reports + 1) * 10) {
+					report(seconds);
+					reports = int(seconds) / 10;
+				}
+			}
+		});
+
+		for (thread& worker : workers) {
+			worker.join();
+		}
+		done = true;
+		reporter.join();
+
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		report(seconds);
+		cout << shards << " shards written to " << settings.output << "_*.bin" << endl;
+		return !failed;
+	}
+
+	void report(double seconds) {
+		unsigned long long games = gamesPlayed;
+		unsigned long long positions = positionsWritten;
+		cout << fixed << setprecision(1) << seconds << " s | " << games << " games | " << positions << " positions | "
+			<< setprecision(0) << double(positions) / seconds << " positions/s" << endl;
+	}
+};
+
+
+int main(int argc, char** argv)
+{
+	DataGenSettings settings = DataGenSettings{};
+	settings.games = 1000;
+	settings.threads = max(1, int(thread::hardware_concurrency()));
+	settings.nodes = 5000;
+	settings.randomPlies = 8;
+	settings.maxPlies = 400;
+	settings.output = "data";
+	settings.shardSize = 1 << 20;
+	settings.seed = 0;
+	settings.resignScore = 1000;
+	settings.resignPlies = 6;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--games" && hasValue) settings.games = max(1, atoi(argv[++i]));
+		else if (arg == "--threads" && hasValue) settings.threads = max(1, atoi(argv[++i]));
+		else if (arg == "--nodes" && hasValue) settings.nodes = max(1ll, atoll(argv[++i]));
+		else if (arg == "--randomplies" && hasValue) settings.randomPlies = max(0, atoi(argv[++i]));
+		else if (arg == "--maxplies" && hasValue) settings.maxPlies = max(1, atoi(argv[++i]));
+		else if (arg == "--output" && hasValue) settings.output = argv[++i];
+		else if (arg == "--shardsize" && hasValue) settings.shardSize = max(1ll, atoll(argv[++i]));
+		else if (arg == "--seed" && hasValue) settings.seed = unsigned(atoi(argv[++i]));
+		else {
+			cout << "usage : datagen [--games N] [--threads N] [--nodes N] [--randomplies N] [--maxplies N]\n"
+				<< "               [--output prefix] [--shardsize records] [--seed N]" << endl;
+			return 1;
+		}
+	}
+
+	cout << "playing " << settings.games << " games of " << settings.nodes << " nodes per move on "
+		<< settings.threads << " threads" << endl;
+
+	DataGenerator generator = DataGenerator(settings);
+	if (!generator.run()) {
+		cout << "could not write the shards " << settings.output << "_*.bin" << endl;
+		return 1;
+	}
+	return 0;
+}
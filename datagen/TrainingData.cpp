@@ -0,0 +1,84 @@
+#include "TrainingData.h"
+#include <algorithm>
+
+using namespace std;
+
+
+ShardWriter::ShardWriter(string newPrefix, int newWriterIndex, size_t newRecordsPerShard, size_t bufferRecords) {
+	prefix = newPrefix;
+	writerIndex = newWriterIndex;
+	recordsPerShard = max(size_t(1), newRecordsPerShard);
+	file = nullptr;
+	shardCount = 0;
+	shardRecords = 0;
+	buffer.reserve(max(size_t(1), bufferRecords));
+	failed = false;
+}
+
+ShardWriter::~ShardWriter()
+{
+	close();
+}
+
+bool ShardWriter::openShard()
+{
+	string path = prefix + "_" + to_string(writerIndex) + "_" + to_string(shardCount) + ".bin";
+	file = fopen(path.c_str(), "wb");
+	if (!file) {
+		failed = true;
+		return false;
+	}
+	TrainingShardHeader header = TrainingShardHeader{ TRAINING_SHARD_MAGIC, TRAINING_SHARD_VERSION, sizeof(TrainingRecord) };
+	fwrite(&header, sizeof(header), 1, file);
+	shardCount++;
+	shardRecords = 0;
+	return true;
+}
+
+void ShardWriter::flushBuffer()
+{
+	size_t written = 0;
+	while (written < buffer.size() && !failed) {
+		if (!file && !openShard()) {
+			break;
+		}
+		size_t count = min(buffer.size() - written, recordsPerShard - shardRecords);
+		if (fwrite(buffer.data() + written, sizeof(TrainingRecord), count, file) != count) {
+			failed = true;
+		}
+		written += count;
+		shardRecords += count;
+		if (shardRecords == recordsPerShard) {
+			fclose(file);
+			file = nullptr;
+		}
+	}
+	buffer.clear();
+}
+
+void ShardWriter::write(const TrainingRecord& record)
+{
+	buffer.push_back(record);
+	if (buffer.size() == buffer.capacity()) {
+		flushBuffer();
+	}
+}
+
+void ShardWriter::close()
+{
+	flushBuffer();
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+bool ShardWriter::isGood()
+{
+	return !failed;
+}
+
+int ShardWriter::getShardCount()
+{
+	return shardCount;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef TRAININGDATA_H
+#define TRAININGDATA_H
+
+#include "Board.h"
+#include <cstdio>
+
+/*
+Training data for the evaluation weights, written in shards.
+
+A shard is a TrainingShardHeader followed by records of recordSize bytes, the number
+of records is given by the size of the file. Shards can be read in any order.
+*/
+
+#define TRAINING_SHARD_MAGIC 0x4E49415254534843ull // "CHSTRAIN"
+#define TRAINING_SHARD_VERSION 1
+
+typedef struct TrainingShardHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t recordSize;
+} TrainingShardHeader;
+
+// the score and the result are from the point of view of the side to move
+typedef struct TrainingRecord {
+	PackedPosition position;
+	int16_t score; // centipawns, from the search
+	int8_t result; // 1 won, 0 draw, -1 lost
+	uint8_t unused[5];
+} TrainingRecord;
+
+
+// writes the records of one thread, nothing is shared so nothing is locked. A new shard
+// is started every recordsPerShard records.
+class ShardWriter {
+private:
+	string prefix;
+	int writerIndex;
+	size_t recordsPerShard;
+
+	FILE* file;
+	int shardCount;
+	size_t shardRecords;
+	vector<TrainingRecord> buffer;
+	bool failed;
+
+	bool openShard();
+	void flushBuffer();
+
+public:
+	// the shards are named prefix_<writerIndex>_<shard>.bin
+	ShardWriter(string newPrefix, int newWriterIndex, size_t newRecordsPerShard, size_t bufferRecords);
+	~ShardWriter();
+
+	void write(const TrainingRecord& record);
+	void close();
+	// false once a shard could not be created or written
+	bool isGood();
+	int getShardCount();
+};
+
+#endif // !TRAININGDATA_H
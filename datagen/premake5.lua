@@ -0,0 +1,26 @@
+-- self-play training data generator, see DataGen.cpp
+
+baseName = path.getbasename(os.getcwd());
+
+project (baseName)
+    kind "ConsoleApp"
+    location "./"
+    targetdir "../bin/%{cfg.buildcfg}"
+
+    filter "action:vs*"
+        debugdir "$(SolutionDir)"
+    filter {}
+
+    vpaths 
+    {
+        ["Header Files/*"] = { "**.h", "**.hpp", "../game/**.h"},
+        ["Source Files/*"] = { "**.cpp", "../game/**.cpp"},
+    }
+    -- reuse the game sources, minus the file holding the game's main()
+    files {"**.cpp", "**.h", "../game/**.cpp", "../game/**.h"}
+    removefiles {"../game/ChessGame.cpp"}
+
+    includedirs { "./" }
+    includedirs { "../game" }
+
+    link_raylib()
@@ -3,6 +3,8 @@
 #include <ctype.h>
 #include <iterator>
 #include <exception>
+#include <algorithm>
+#include <sstream>
 
 //DEBUG :
 #include <iostream>
@@ -14,6 +16,45 @@ using namespace std;
 const std::vector<char> Board::pieces = { 'K', 'Q', 'B', 'N', 'R', 'P', 'k', 'q', 'b', 'n', 'r', 'p' };
 
 
+/*
+Random keys of the Zobrist hash : https://www.chessprogramming.org/Zobrist_Hashing
+The seed is fixed so a position has the same hash from one run to the other.
+*/
+struct ZobristKeys {
+	U64 pieces[12][64];
+	U64 WToMove;
+	U64 enPassantColumn[8];
+
+	ZobristKeys() {
+		U64 seed = 0x9E3779B97F4A7C15ull;
+		for (int piece = 0; piece < 12; piece++) {
+			for (int square = 0; square < 64; square++) {
+				pieces[piece][square] = nextKey(seed);
+			}
+		}
+		WToMove = nextKey(seed);
+		for (int column = 0; column < 8; column++) {
+			enPassantColumn[column] = nextKey(seed);
+		}
+	}
+
+	// splitmix64
+	static U64 nextKey(U64& seed) {
+		U64 key = (seed += 0x9E3779B97F4A7C15ull);
+		key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+		key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+		return key ^ (key >> 31);
+	}
+};
+
+static const ZobristKeys zobrist;
+
+static Vector2Int squareOf(int square)
+{
+	return Vector2Int{ square % 8, square / 8 };
+}
+
+
 Board::Board(
 	struct Color newWhiteColor,
 	struct Color newBlackColor,
@@ -28,10 +69,31 @@ Board::Board(
 	boardSize = newBoardSize;
 	pos = newPos;
 	squareSize = boardSize / 8;
+	attackInfoComputations = 0;
 	state = ReadFEN(startingFENState);
 	piecesTextures = LoadPiecesImages();
 
 	squareSelected = Vector2Int{ -1, -1 };
+	history = PositionHistory{};
+	pushHistory(history, state.hash);
+	gameStatus = getGameStatus(state, history);
+	gameOver = gameStatus != Ongoing;
+}
+
+Board::Board(std::string startingFENState) {
+	whiteColor = Color{ 0, 0, 0, 0 };
+	blackColor = Color{ 0, 0, 0, 0 };
+	boardSize = 0;
+	pos = Vector2{ 0, 0 };
+	squareSize = 0;
+	attackInfoComputations = 0;
+	state = ReadFEN(startingFENState);
+
+	squareSelected = Vector2Int{ -1, -1 };
+	history = PositionHistory{};
+	pushHistory(history, state.hash);
+	gameStatus = getGameStatus(state, history);
+	gameOver = gameStatus != Ongoing;
 }
 
 
@@ -55,11 +117,20 @@ void Board::drawBoard() {
 			getValidMovesBitBoard(squareSelected, whatIsOnSquare(squareSelected), state));
 	}
 
-	for (int i = 0; i < pieces.size(); i++) {
-		drawBitBoard(Color{ 255, 0, 0, 100 }, state.piecesBitmaps[pieces[i]], piecesTextures[pieces[i]]);
+	for (int square = 0; square < 64; square++) {
+		char piece = state.mailbox[square];
+		if (piece) {
+			DrawTexture(
+				piecesTextures[piece],
+				int(pos.x) + square % 8 * squareSize,
+				int(pos.y) + square / 8 * squareSize,
+				WHITE);
+		}
 	}
 
-	drawBitBoard(Color{ 0,0,255,100 }, getAttackedSquaresBy(state.WToMove, state));
+	// computed once per position, the next frames reuse it
+	updateAttackInfo(state);
+	drawBitBoard(Color{ 0,0,255,100 }, state.attackedBy[state.WToMove ? White : Black]);
 	drawBitBoard(Color{ 0, 255, 0, 100 }, getMaskBitBoard(state.enPassant));
 	
 	// draw the turn number
@@ -67,6 +138,18 @@ void Board::drawBoard() {
 
 	// indicate whose turn is is : 
 	string text = "Your Turn";
+	if (gameStatus == Checkmate) {
+		text = "Checkmate";
+	}
+	else if (gameStatus == Stalemate) {
+		text = "Stalemate";
+	}
+	else if (gameStatus == ThreefoldRepetition) {
+		text = "Repetition";
+	}
+	else if (gameStatus == FiftyMoveRule) {
+		text = "50 moves";
+	}
 	DrawText(text.c_str(), squareSize * 8 + squareSize / 4, squareSize + state.WToMove * (squareSize * 6), 50, BLACK);
 
 
@@ -74,6 +157,10 @@ void Board::drawBoard() {
 
 
 void Board::onMouseClick(){
+	if (gameOver) {
+		return;
+	}
+
 	if (squareSelected.x == -1) {
 		squareSelected = processClick(GetMouseX(), GetMouseY());
 
@@ -96,10 +183,9 @@ void Board::onMouseClick(){
 		Vector2Int targetSquare = processClick(GetMouseX(), GetMouseY());
 		if (targetSquare.x != -2) {
 			if (safeMovePiece(squareSelected, targetSquare)) {
-				state.WToMove = !state.WToMove;
-				if (state.WToMove) {
-					state.turn += 1;
-				}
+				pushHistory(history, state.hash);
+				gameStatus = getGameStatus(state, history);
+				gameOver = gameStatus != Ongoing;
 			}
 		}
 		squareSelected.x = -1;
@@ -109,8 +195,7 @@ void Board::onMouseClick(){
 /*
 Uses the state variable to access the bitboards and whose turn it is to move
 TODO :
- - en Passant
- - checkmate
+ - castling
 */
 bool Board::safeMovePiece(Vector2Int from, Vector2Int to) {
 	// first find what piece is on the from square (assumes 1 piece per square)
@@ -125,119 +210,435 @@ bool Board::safeMovePiece(Vector2Int from, Vector2Int to) {
 
 
 	// now that we know the move is valid
-	state = movePiece(from, to, state);
+	state = makeMove(Move{ from, to }, state);
 	return true;
 }
 
 // doesn't do any checks, assumes the to square is either empty or as an enemy piece that needs to be killeds
-BoardState Board::movePiece(Vector2Int from, Vector2Int to, BoardState oldState)
+BoardState Board::movePiece(Vector2Int from, Vector2Int to, const BoardState& oldState)
 {
+	if (isupper(whatIsOnSquare(from, oldState))) {
+		return movePiece<White>(from, to, oldState);
+	}
+	return movePiece<Black>(from, to, oldState);
+}
+
+template <Side S>
+BoardState Board::movePiece(Vector2Int from, Vector2Int to, const BoardState& oldState)
+{
+	typedef SideTraits<S> Us;
+	typedef SideTraits<Us::opponent> Them;
+
 	BoardState newState = oldState;
 	// first find what piece is on the from square (assumes 1 piece per square)
-	char pieceOnSquare = whatIsOnSquare(from, newState);
+	char pieceOnSquare = whatIsOnSquareOf<S>(from, newState);
 
 	// check if the target square is occupied by enemy, if so kill it
-	char enemyPiece = whatIsOnSquare(to, newState); // can't be a friendly piece since it was checked before
+	char enemyPiece = whatIsOnSquareOf<Us::opponent>(to, newState);
 	if (enemyPiece) { // false if the square is empty
-		newState = removePiece(to, enemyPiece, newState);
+		removePiece(to, enemyPiece, newState);
 	}
 
 
 	// check that there is no piece on the to square
-	bool empty = !whatIsOnSquare(to, newState);
+	if (whatIsOnSquareOf<S>(to, newState)) {
+		throw std::runtime_error("there was still a piece on the target square");
+	}
+
+	removePiece(from, pieceOnSquare, newState);
+	addPiece(to, pieceOnSquare, newState);
+	if (oldState.enPassant.x != -1) {
+		newState.hash ^= zobrist.enPassantColumn[oldState.enPassant.x];
+	}
+	newState.enPassant = Vector2Int{ -1, -1 };
 
-	if (empty) {
-		newState = removePiece(from, pieceOnSquare, newState);
-		newState = addPiece(to, pieceOnSquare, newState);
+	if (pieceOnSquare == Us::pawn || enemyPiece) {
+		newState.halfMoveClock = 0;
 	}
 	else {
-		throw std::runtime_error("there was still a piece on the target square");
+		newState.halfMoveClock = oldState.halfMoveClock + 1;
 	}
 
-	// kill pawn that was a victim of enPassant :
-	if (to == oldState.enPassant && (pieceOnSquare == 'p' || pieceOnSquare == 'P')) {
-		if (isupper(pieceOnSquare)) {
-			newState = removePiece(Vector2Int{ oldState.enPassant.x, oldState.enPassant.y + 1 }, 'p', oldState);
+	if (pieceOnSquare == Us::pawn) {
+		// kill pawn that was a victim of enPassant :
+		if (to == oldState.enPassant) {
+			removePiece(Vector2Int{ to.x, to.y - Us::pawnDirection }, Them::pawn, newState);
 		}
-		else {
-			newState = removePiece(Vector2Int{ oldState.enPassant.x, oldState.enPassant.y - 1 }, 'P', oldState);
+
+		// promotion, always to a queen for now
+		if (to.y == Us::promotionRow) {
+			removePiece(to, Us::pawn, newState);
+			addPiece(to, Us::queen, newState);
+		}
+
+		// save EnPassant opportunity :
+		if (from.y == Us::pawnHomeRow && to.y == from.y + 2 * Us::pawnDirection) {
+			newState.enPassant = Vector2Int{ to.x, from.y + Us::pawnDirection };
+			newState.hash ^= zobrist.enPassantColumn[to.x];
 		}
 	}
 
+#ifndef NDEBUG
+	checkMailbox(newState);
+#endif
+
+	return newState;
+}
 
-	// save EnPassant opportunity :
-	if ((pieceOnSquare == 'p' || pieceOnSquare == 'P') && (from.y == 1 || from.y == 6) && (to.y == 3 || to.y == 4)) {
-		if (to.y == 3) {
-			newState.enPassant = Vector2Int{ to.x, 2 };
+PackedPosition Board::packPosition(const BoardState& workingState)
+{
+	PackedPosition packed = PackedPosition{};
+	int count = 0;
+	for (int square = 0; square < 64; square++) {
+		char piece = workingState.mailbox[square];
+		if (!piece) {
+			continue;
 		}
-		else if (to.y == 4) {
-			newState.enPassant = Vector2Int{ to.x, 5 };
+		if (count == 32) {
+			throw std::runtime_error("only 32 pieces fit in a packed position");
 		}
-		else {
-			cout << "ERROR : there was an issue in move Piece in the save En passant opportunity logic" << endl;
+		packed.occupancy |= 1ull << square;
+		packed.pieces[count / 2] |= pieceIndex(piece) << (4 * (count % 2));
+		count++;
+	}
+
+	packed.flags = workingState.WToMove ? 1 : 0;
+	if (workingState.enPassant.x != -1) {
+		packed.flags |= (workingState.enPassant.x + 1) << 1;
+	}
+	// the clock stops counting at 100 anyway
+	packed.halfMoveClock = uint8_t(min(workingState.halfMoveClock, 255u));
+	packed.turn = uint16_t(workingState.turn);
+	return packed;
+}
+
+BoardState Board::unpackPosition(const PackedPosition& packed)
+{
+	BoardState unpacked = BoardState{};
+	// the packed positions also come from files, which may be corrupt
+	if (((packed.flags >> 1) & 0xF) > 8) {
+		throw std::runtime_error("corrupt packed position");
+	}
+	int count = 0;
+	for (int square = 0; square < 64; square++) {
+		if (!(packed.occupancy & (1ull << square))) {
+			continue;
+		}
+		if (count == 32) {
+			throw std::runtime_error("corrupt packed position");
+		}
+		int index = (packed.pieces[count / 2] >> (4 * (count % 2))) & 0xF;
+		if (index >= 12) {
+			throw std::runtime_error("corrupt packed position");
 		}
+		char piece = pieces[index];
+		unpacked.piecesBitmaps[piece] |= 1ull << square;
+		unpacked.mailbox[square] = piece;
+		count++;
+	}
+
+	unpacked.WToMove = packed.flags & 1;
+	int enPassantColumn = (packed.flags >> 1) & 0xF;
+	// the en passant square is behind the pawn that just moved two squares
+	unpacked.enPassant = enPassantColumn
+		? Vector2Int{ enPassantColumn - 1, unpacked.WToMove ? 2 : 5 }
+		: Vector2Int{ -1, -1 };
+	unpacked.halfMoveClock = packed.halfMoveClock;
+	unpacked.turn = packed.turn;
+	unpacked.hash = computeHash(unpacked);
+	return unpacked;
+}
+
+string Board::getFEN(const BoardState& workingState)
+{
+	string FEN;
+	for (int y = 0; y < 8; y++) {
+		int empty = 0;
+		for (int x = 0; x < 8; x++) {
+			char piece = workingState.mailbox[x + y * 8];
+			if (!piece) {
+				empty++;
+				continue;
+			}
+			if (empty) {
+				FEN += char('0' + empty);
+				empty = 0;
+			}
+			FEN += piece;
+		}
+		if (empty) {
+			FEN += char('0' + empty);
+		}
+		if (y < 7) {
+			FEN += '/';
+		}
+	}
+
+	FEN += workingState.WToMove ? " w - " : " b - ";
+	if (workingState.enPassant.x != -1) {
+		FEN += char('a' + workingState.enPassant.x);
+		FEN += char('8' - workingState.enPassant.y);
+	}
+	else {
+		FEN += '-';
+	}
+	FEN += " " + to_string(workingState.halfMoveClock) + " " + to_string(workingState.turn);
+	return FEN;
+}
+
+BoardState Board::getState()
+{
+	return state;
+}
+
+vector<Move> Board::getLegalMoves(BoardState& workingState)
+{
+	MoveList moves;
+	getLegalMoves(workingState, moves);
+	return vector<Move>(moves.begin(), moves.end());
+}
+
+void Board::getLegalMoves(BoardState& workingState, MoveList& moves)
+{
+	if (workingState.WToMove) {
+		getLegalMoves<White>(workingState, ~0ull, moves);
+	}
+	else {
+		getLegalMoves<Black>(workingState, ~0ull, moves);
+	}
+}
+
+void Board::getLegalCaptures(BoardState& workingState, MoveList& moves)
+{
+	U64 targets = getCaptureTargets(workingState);
+	if (workingState.WToMove) {
+		getLegalMoves<White>(workingState, targets, moves);
+	}
+	else {
+		getLegalMoves<Black>(workingState, targets, moves);
+	}
+}
+
+void Board::getLegalQuietMoves(BoardState& workingState, MoveList& moves)
+{
+	U64 targets = ~getCaptureTargets(workingState);
+	if (workingState.WToMove) {
+		getLegalMoves<White>(workingState, targets, moves);
 	}
 	else {
-		newState.enPassant = Vector2Int{ -1, -1 };
+		getLegalMoves<Black>(workingState, targets, moves);
+	}
+}
+
+template <Side S>
+void Board::getLegalMoves(BoardState& workingState, U64 targets, MoveList& moves)
+{
+	moves.clear();
+	// once here rather than for each piece
+	updateAttackInfo(workingState);
+
+	for (char piece : SideTraits<S>::allies) {
+		for (U64 squares = workingState.piecesBitmaps[piece]; squares; squares &= squares - 1) {
+			Vector2Int from = squareOf(lowestSquare(squares));
+			for (U64 to = getValidMovesBitBoard<S>(from, piece, workingState, targets); to; to &= to - 1) {
+				moves.push(Move{ from, squareOf(lowestSquare(to)) });
+			}
+		}
 	}
+}
+
+bool Board::isLegalMove(Move move, BoardState& workingState)
+{
+	if (move.from.x < 0 || move.from.y < 0 || move.from.x > 7 || move.from.y > 7
+		|| move.to.x < 0 || move.to.y < 0 || move.to.x > 7 || move.to.y > 7) {
+		return false;
+	}
+
+	char piece = workingState.mailbox[move.from.x + move.from.y * 8];
+	if (!piece || bool(isupper(piece)) != workingState.WToMove) {
+		return false;
+	}
+
+	updateAttackInfo(workingState);
+	U64 target = getMaskBitBoard(move.to);
+	if (workingState.WToMove) {
+		return getValidMovesBitBoard<White>(move.from, piece, workingState, target);
+	}
+	return getValidMovesBitBoard<Black>(move.from, piece, workingState, target);
+}
+
+bool Board::isCapture(Move move, const BoardState& workingState)
+{
+	return workingState.mailbox[move.to.x + move.to.y * 8] || move.to == workingState.enPassant;
+}
+
+// same turn logic as onMouseClick
+BoardState Board::makeMove(Move move, const BoardState& workingState)
+{
+	if (workingState.WToMove) {
+		return makeMove<White>(move, workingState);
+	}
+	return makeMove<Black>(move, workingState);
+}
+
+template <Side S>
+BoardState Board::makeMove(Move move, const BoardState& workingState)
+{
+	BoardState newState = movePiece<S>(move.from, move.to, workingState);
+	newState.WToMove = !SideTraits<S>::isWhite;
+	newState.hash ^= zobrist.WToMove;
+	if (newState.WToMove) {
+		newState.turn += 1;
+	}
+
+#ifndef NDEBUG
+	if (newState.hash != computeHash(newState)) {
+		throw std::runtime_error("the hash is out of sync with the position");
+	}
+#endif
 
 	return newState;
 }
 
+// counts the leaf nodes of the move tree, https://www.chessprogramming.org/Perft
+U64 Board::perft(BoardState workingState, int depth)
+{
+	MoveList moves;
+	getLegalMoves(workingState, moves);
+	if (depth <= 1) {
+		return depth == 1 ? moves.size() : 1;
+	}
+
+	U64 nodes = 0;
+	for (const Move& move : moves) {
+		nodes += perft(makeMove(move, workingState), depth - 1);
+	}
+	return nodes;
+}
+
+bool Board::hasLegalMove(BoardState& workingState)
+{
+	if (workingState.WToMove) {
+		return hasLegalMove<White>(workingState);
+	}
+	return hasLegalMove<Black>(workingState);
+}
+
+template <Side S>
+bool Board::hasLegalMove(BoardState& workingState)
+{
+	updateAttackInfo(workingState);
+
+	// the king first, it is the piece most likely to have a move when in check
+	for (char piece : SideTraits<S>::allies) {
+		for (U64 squares = workingState.piecesBitmaps[piece]; squares; squares &= squares - 1) {
+			if (getValidMovesBitBoard<S>(squareOf(lowestSquare(squares)), piece, workingState)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+GameStatus Board::getGameStatus(BoardState& workingState, const PositionHistory& positionHistory)
+{
+	if (!hasLegalMove(workingState)) {
+		return isInCheck(workingState) ? Checkmate : Stalemate;
+	}
+	if (workingState.halfMoveClock >= 100) {
+		return FiftyMoveRule;
+	}
+	if (countRepetitions(positionHistory, workingState) >= 3) {
+		return ThreefoldRepetition;
+	}
+	return Ongoing;
+}
+
+bool Board::isInCheck(const BoardState& workingState)
+{
+	if (workingState.attackInfoValid) {
+		return workingState.checkers;
+	}
+	if (workingState.WToMove) {
+		return isInCheckBy<Black>(workingState);
+	}
+	return isInCheckBy<White>(workingState);
+}
+
+U64 Board::getAttackedSquares(Side side, BoardState& workingState)
+{
+	updateAttackInfo(workingState);
+	return workingState.attackedBy[side];
+}
+
 U64 Board::getMaskBitBoard(Vector2Int square) {
 	if (square.x == -1 || square.y == -1) {
 		return 0ull;
 	}
 	else if (square.x < 0 || square.y < 0 || square.x > 7 || square.y > 7) {
-		cout << "ERROR : in getMaskBitBoard, square out of range !" << endl;
+		// on stderr, the server answers on stdout
+		cerr << "ERROR : in getMaskBitBoard, square out of range !" << endl;
 		return 0ull;
 	}
 
 	return static_cast<U64>(1) << (square.x + square.y * 8);
 }
 
-U64 Board::getAttacksBitBoard(Vector2Int square, char piece, BoardState workingState)
+template <Side S>
+U64 Board::getAttacksBitBoard(Vector2Int square, char piece, const BoardState& workingState)
 {
+	typedef SideTraits<S> Us;
+
 	U64 attacks = 0ull;
-	if (piece == 'n' || piece == 'N') {
+	if (piece == Us::knight) {
 		attacks = getValidMovesBitBoardKnight(square, workingState);
 	}
-	else if (piece == 'p' || piece == 'P') {
-		attacks = getValidAttacksPawn(square, isupper(piece), workingState);
+	else if (piece == Us::pawn) {
+		attacks = getValidAttacksPawn<S>(square, workingState);
 	}
-	else if (piece == 'r' || piece == 'R') {
+	else if (piece == Us::rook) {
 		attacks = getValidMovesBitBoardRook(square, workingState);
 	}
-	else if (piece == 'b' || piece == 'B') {
+	else if (piece == Us::bishop) {
 		attacks = getValidMovesBitBoardBishop(square, workingState);
 	}
-	else if (piece == 'q' || piece == 'Q') {
+	else if (piece == Us::queen) {
 		attacks = getValidMovesBitBoardQueen(square, workingState);
 	}
-	else if (piece == 'k' || piece == 'K') {
+	else if (piece == Us::king) {
 		attacks = getValidMovesBitBoardKing(square, workingState);
 	}
 
 	return attacks;
 }
 
-U64 Board::getValidMovesBitBoard(Vector2Int square, char piece, BoardState workingState)
+U64 Board::getValidMovesBitBoard(Vector2Int square, char piece, BoardState& workingState)
+{
+	if (isupper(piece)) {
+		return getValidMovesBitBoard<White>(square, piece, workingState);
+	}
+	return getValidMovesBitBoard<Black>(square, piece, workingState);
+}
+
+template <Side S>
+U64 Board::getValidMovesBitBoard(Vector2Int square, char piece, BoardState& workingState, U64 targets)
 {
 	U64 validMoves;
-	if (piece == 'p' || piece == 'P') {
-		validMoves = getValidMovesBitBoardPawn(square, isupper(piece), workingState);
+	if (piece == SideTraits<S>::pawn) {
+		validMoves = getValidMovesBitBoardPawn<S>(square, workingState);
 	}
 	else {
-		validMoves = getAttacksBitBoard(square, piece, workingState);
+		validMoves = getAttacksBitBoard<S>(square, piece, workingState);
 	}
-	validMoves = removeAllies(validMoves, getAllies(isupper(piece)));
-	validMoves = removeChecksFromPossibleMoves(validMoves, square, piece);
+	// filtered before the legality test, the most expensive part
+	validMoves = removeAllies<S>(validMoves, workingState) & targets;
+	validMoves = removeChecksFromPossibleMoves<S>(validMoves, square, piece, workingState);
 	return validMoves;
 }
 
 
 
-U64 Board::getValidMovesBitBoardKnight(Vector2Int square, BoardState workingState)
+U64 Board::getValidMovesBitBoardKnight(Vector2Int square, const BoardState& workingState)
 {
 	// for a knight in position (2, 2)
 	//     0  x  0  x  0  0  0  0
@@ -258,59 +659,51 @@ U64 Board::getValidMovesBitBoardKnight(Vector2Int square, BoardState workingStat
 	return  finalMask;
 }
 
-U64 Board::getValidMovesBitBoardPawn(Vector2Int square, bool isWhite, BoardState workingState)
+U64 Board::getValidMovesBitBoardPawn(Vector2Int square, bool isWhite, const BoardState& workingState)
 {
-	U64 finalBitBoard = 0;
-	int direction;
-	bool onHomeRow = false;
 	if (isWhite) {
-		direction = -1;
-		if (square.y == 6) {
-			onHomeRow = true;
-		}
-	}
-	else {
-		direction = 1;
-		if (square.y == 1) {
-			onHomeRow = true;
-		}
+		return getValidMovesBitBoardPawn<White>(square, workingState);
 	}
+	return getValidMovesBitBoardPawn<Black>(square, workingState);
+}
+
+template <Side S>
+U64 Board::getValidMovesBitBoardPawn(Vector2Int square, const BoardState& workingState)
+{
+	typedef SideTraits<S> Us;
+
+	U64 finalBitBoard = 0;
+	Vector2Int oneStep = Vector2Int{ square.x, square.y + Us::pawnDirection };
+	Vector2Int twoSteps = Vector2Int{ square.x, square.y + 2 * Us::pawnDirection };
 
-	if (!whatIsOnSquare(Vector2Int{ square.x, square.y + direction }, pieces, workingState)) {
-		finalBitBoard |= getMaskBitBoard(Vector2Int{ square.x, square.y + direction });
-		if (onHomeRow && !whatIsOnSquare(Vector2Int{ square.x, square.y + 2 * direction }, pieces, workingState)) {
-			finalBitBoard |= getMaskBitBoard(Vector2Int{ square.x, square.y + 2 * direction });
+	if (!whatIsOnSquare(oneStep, workingState)) {
+		finalBitBoard |= getMaskBitBoard(oneStep);
+		if (square.y == Us::pawnHomeRow && !whatIsOnSquare(twoSteps, workingState)) {
+			finalBitBoard |= getMaskBitBoard(twoSteps);
 		}
 	}
 
 	// attacks
-	finalBitBoard |= getValidAttacksPawn(square, isWhite, workingState);
-
-	
+	finalBitBoard |= getValidAttacksPawn<S>(square, workingState);
 
 	return finalBitBoard;
 }
 
-U64 Board::getValidAttacksPawn(Vector2Int square, bool isWhite, BoardState workingState)
+template <Side S>
+U64 Board::getValidAttacksPawn(Vector2Int square, const BoardState& workingState)
 {
+	constexpr int direction = SideTraits<S>::pawnDirection;
 	U64 finalBitBoard = 0;
-	int direction;
-	if (isWhite) {
-		direction = -1;
-	}
-	else {
-		direction = 1;
-	}
 
 	// attacks
-	if (square.x - 1 >= 0 && whatIsOnSquare(Vector2Int{ square.x - 1, square.y + direction }, pieces, workingState)) {
+	if (square.x - 1 >= 0 && whatIsOnSquare(Vector2Int{ square.x - 1, square.y + direction }, workingState)) {
 		finalBitBoard |= getMaskBitBoard(Vector2Int{ square.x - 1, square.y + direction });
 	}
-	if (square.x + 1 < 8 && whatIsOnSquare(Vector2Int{ square.x + 1, square.y + direction }, pieces, workingState)) {
+	if (square.x + 1 < 8 && whatIsOnSquare(Vector2Int{ square.x + 1, square.y + direction }, workingState)) {
 		finalBitBoard |= getMaskBitBoard(Vector2Int{ square.x + 1, square.y + direction });
 	}
 
-	// TODO en passant !
+	// en passant
 	if (square.y + direction == workingState.enPassant.y) {
 		if (square.x + 1 == workingState.enPassant.x || square.x - 1 == workingState.enPassant.x) {
 			finalBitBoard |= getMaskBitBoard(workingState.enPassant);
@@ -321,7 +714,7 @@ U64 Board::getValidAttacksPawn(Vector2Int square, bool isWhite, BoardState worki
 }
 
 // ugly implementation really not proud of this
-U64 Board::getValidMovesBitBoardRook(Vector2Int square, BoardState workingState) {
+U64 Board::getValidMovesBitBoardRook(Vector2Int square, const BoardState& workingState) {
 	U64 finalMask;
 
 	finalMask = 0ull;
@@ -371,7 +764,7 @@ U64 Board::getValidMovesBitBoardRook(Vector2Int square, BoardState workingState)
 	return finalMask;
 }
 
-U64 Board::getValidMovesBitBoardBishop(Vector2Int square, BoardState workingState)
+U64 Board::getValidMovesBitBoardBishop(Vector2Int square, const BoardState& workingState)
 {
 	U64 finalMask = 0ull;
 
@@ -419,12 +812,12 @@ U64 Board::getValidMovesBitBoardBishop(Vector2Int square, BoardState workingStat
 	return finalMask;
 }
 
-U64 Board::getValidMovesBitBoardQueen(Vector2Int square, BoardState workingState)
+U64 Board::getValidMovesBitBoardQueen(Vector2Int square, const BoardState& workingState)
 {
 	return getValidMovesBitBoardRook(square, workingState) | getValidMovesBitBoardBishop(square, workingState);
 }
 
-U64 Board::getValidMovesBitBoardKing(Vector2Int square, BoardState workingState)
+U64 Board::getValidMovesBitBoardKing(Vector2Int square, const BoardState& workingState)
 {
 	U64 finalMask = 0ull;
 
@@ -468,49 +861,344 @@ U64 Board::shiftMask(U64 baseMask, Vector2Int shift)
 	return finalMask;
 }
 
-U64 Board::getAttackedSquaresBy(bool isWhite, BoardState positions)
+U64 Board::getAttackedSquaresBy(bool isWhite, const BoardState& positions)
+{
+	if (isWhite) {
+		return getAttackedSquaresBy<White>(positions);
+	}
+	return getAttackedSquaresBy<Black>(positions);
+}
+
+template <Side S>
+U64 Board::getAttackedSquaresBy(const BoardState& positions)
 {
-	vector<char> attackers = getAllies(isWhite);
 	U64 attackedSquares = 0ull;
 
-	for (char piece : attackers) {
-		for (Vector2Int piecePosition : getAllPosInBitBoard(positions.piecesBitmaps[piece])) {
-			attackedSquares |= getAttacksBitBoard(piecePosition, piece, positions);
+	for (char piece : SideTraits<S>::allies) {
+		for (U64 squares = positions.piecesBitmaps[piece]; squares; squares &= squares - 1) {
+			attackedSquares |= getAttacksBitBoard<S>(squareOf(lowestSquare(squares)), piece, positions);
 		}
 	}
 
 	return attackedSquares;
 }
 
-bool Board::isInCheckBy(bool isWhite, BoardState positions)
+// is side S giving check
+template <Side S>
+bool Board::isInCheckBy(const BoardState& positions)
 {
-	U64 attackedSquares = getAttackedSquaresBy(isWhite, positions);
-	/*cout << "attackedSquares :";
-	print(attackedSquares);
-	cout << "king position :  ";
-	print(positions.piecesBitmaps[getAllies(!isWhite)[0]]);*/
-	// WPieces and BPieces have the king in first position
-	return attackedSquares & positions.piecesBitmaps[getAllies(!isWhite)[0]];
+	U64 kingBitBoard = positions.piecesBitmaps[SideTraits<SideTraits<S>::opponent>::king];
+	if (!kingBitBoard) {
+		return false;
+	}
+	Vector2Int kingSquare = squareOf(lowestSquare(kingBitBoard));
+	return getAttackersTo<S>(kingSquare, getOccupancy(positions), positions);
 }
 
-U64 Board::removeChecksFromPossibleMoves(U64 possibleMoves, Vector2Int square, char piece)
+template <Side S>
+U64 Board::removeChecksFromPossibleMoves(U64 possibleMoves, Vector2Int square, char piece, BoardState& workingState)
 {
-	//cout << "piece : " << piece << endl;
+	typedef SideTraits<S> Us;
+
+	// the attack information only covers the side to move
+	if (Us::isWhite == workingState.WToMove) {
+		updateAttackInfo(workingState);
+
+		if (piece == Us::king) {
+			// the enemy attacks go through our king so it can't step back along a checking line
+			return possibleMoves & ~workingState.attackedBy[Us::opponent];
+		}
+
+		// nothing can go wrong when moving a piece that is not pinned while not in check,
+		// except en passant that removes two pieces from the capture row
+		bool enPassantCapture = piece == Us::pawn && (possibleMoves & getMaskBitBoard(workingState.enPassant));
+		if (!workingState.checkers && !(workingState.pinned & getMaskBitBoard(square)) && !enPassantCapture) {
+			return possibleMoves;
+		}
+	}
+
+	// otherwise play each move and look for a check
 	U64 newPossibleMoves = possibleMoves;
 
-	for (Vector2Int move : getAllPosInBitBoard(possibleMoves)) {
-		if (isInCheckBy(islower(piece), movePiece(square, move, state))) {
-			//cout << "found invalid move, before : ";
-			//print(newPossibleMoves);
+	for (U64 moves = possibleMoves; moves; moves &= moves - 1) {
+		Vector2Int move = squareOf(lowestSquare(moves));
+		if (isInCheckBy<Us::opponent>(movePiece<S>(square, move, workingState))) {
 			newPossibleMoves &= ~getMaskBitBoard(move);
-			//cout << "after :                      ";
-			//print(newPossibleMoves);
 		}
 	}
 
 	return newPossibleMoves;
 }
 
+void Board::updateAttackInfo(BoardState& workingState)
+{
+	if (workingState.attackInfoValid) {
+		return;
+	}
+	attackInfoComputations++;
+	if (workingState.WToMove) {
+		computeAttackInfo<White>(workingState);
+	}
+	else {
+		computeAttackInfo<Black>(workingState);
+	}
+}
+
+// S is the side to move
+template <Side S>
+void Board::computeAttackInfo(BoardState& workingState)
+{
+	typedef SideTraits<S> Us;
+	typedef SideTraits<Us::opponent> Them;
+
+	U64 occupancy = getOccupancy(workingState);
+	U64 ourKing = workingState.piecesBitmaps[Us::king];
+	U64 theirKing = workingState.piecesBitmaps[Them::king];
+
+	// each side attacks through the enemy king
+	workingState.attackedBy[S] = getAllAttacks<S>(occupancy & ~theirKing, workingState);
+	workingState.attackedBy[Us::opponent] = getAllAttacks<Us::opponent>(occupancy & ~ourKing, workingState);
+
+	workingState.checkers = 0ull;
+	workingState.pinned = 0ull;
+	if (ourKing) {
+		Vector2Int kingSquare = squareOf(lowestSquare(ourKing));
+		workingState.checkers = getAttackersTo<Us::opponent>(kingSquare, occupancy, workingState);
+		workingState.pinned = getPinnedPieces<S>(kingSquare, workingState);
+	}
+
+	workingState.attackInfoValid = true;
+}
+
+// unlike getAttackedSquaresBy the pawns attack empty squares too
+template <Side S>
+U64 Board::getAllAttacks(U64 occupancy, const BoardState& workingState)
+{
+	typedef SideTraits<S> Us;
+	U64 attacks = 0ull;
+
+	for (U64 squares = workingState.piecesBitmaps[Us::pawn]; squares; squares &= squares - 1) {
+		attacks |= getPawnAttacks<S>(squareOf(lowestSquare(squares)));
+	}
+	for (U64 squares = workingState.piecesBitmaps[Us::knight]; squares; squares &= squares - 1) {
+		attacks |= getValidMovesBitBoardKnight(squareOf(lowestSquare(squares)), workingState);
+	}
+	for (U64 squares = workingState.piecesBitmaps[Us::bishop] | workingState.piecesBitmaps[Us::queen]; squares; squares &= squares - 1) {
+		attacks |= getBishopAttacks(squareOf(lowestSquare(squares)), occupancy);
+	}
+	for (U64 squares = workingState.piecesBitmaps[Us::rook] | workingState.piecesBitmaps[Us::queen]; squares; squares &= squares - 1) {
+		attacks |= getRookAttacks(squareOf(lowestSquare(squares)), occupancy);
+	}
+	for (U64 squares = workingState.piecesBitmaps[Us::king]; squares; squares &= squares - 1) {
+		attacks |= getValidMovesBitBoardKing(squareOf(lowestSquare(squares)), workingState);
+	}
+
+	return attacks;
+}
+
+// pieces of side S attacking the square, whatever is on it
+template <Side S>
+U64 Board::getAttackersTo(Vector2Int square, U64 occupancy, const BoardState& workingState)
+{
+	typedef SideTraits<S> Us;
+
+	U64 straightSliders = workingState.piecesBitmaps[Us::rook] | workingState.piecesBitmaps[Us::queen];
+	U64 diagonalSliders = workingState.piecesBitmaps[Us::bishop] | workingState.piecesBitmaps[Us::queen];
+
+	// a pawn of S attacks the square if a pawn of the other side on the square would attack it
+	return (getPawnAttacks<Us::opponent>(square) & workingState.piecesBitmaps[Us::pawn])
+		| (getValidMovesBitBoardKnight(square, workingState) & workingState.piecesBitmaps[Us::knight])
+		| (getValidMovesBitBoardKing(square, workingState) & workingState.piecesBitmaps[Us::king])
+		| (getRookAttacks(square, occupancy) & straightSliders)
+		| (getBishopAttacks(square, occupancy) & diagonalSliders);
+}
+
+// pieces of side S that are the only thing between their king and an enemy slider
+template <Side S>
+U64 Board::getPinnedPieces(Vector2Int kingSquare, const BoardState& workingState)
+{
+	typedef SideTraits<SideTraits<S>::opponent> Them;
+	const Vector2Int directions[8] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+
+	U64 pinned = 0ull;
+	for (int i = 0; i < 8; i++) {
+		bool diagonal = directions[i].x != 0 && directions[i].y != 0;
+		Vector2Int candidate = Vector2Int{ -1, -1 };
+
+		Vector2Int current = Vector2Int{ kingSquare.x + directions[i].x, kingSquare.y + directions[i].y };
+		while (current.x >= 0 && current.x < 8 && current.y >= 0 && current.y < 8) {
+			char piece = whatIsOnSquare(current, workingState);
+			if (piece) {
+				if (candidate.x == -1 && whatIsOnSquareOf<S>(current, workingState)) {
+					candidate = current;
+				}
+				else {
+					bool pins = piece == Them::queen || piece == (diagonal ? Them::bishop : Them::rook);
+					if (candidate.x != -1 && pins) {
+						pinned |= getMaskBitBoard(candidate);
+					}
+					break;
+				}
+			}
+			current = Vector2Int{ current.x + directions[i].x, current.y + directions[i].y };
+		}
+	}
+
+	return pinned;
+}
+
+template <Side S>
+U64 Board::getPawnAttacks(Vector2Int square)
+{
+	int y = square.y + SideTraits<S>::pawnDirection;
+	if (y < 0 || y > 7) {
+		return 0ull;
+	}
+
+	U64 attacks = 0ull;
+	if (square.x > 0) {
+		attacks |= static_cast<U64>(1) << (square.x - 1 + y * 8);
+	}
+	if (square.x < 7) {
+		attacks |= static_cast<U64>(1) << (square.x + 1 + y * 8);
+	}
+	return attacks;
+}
+
+U64 Board::getRookAttacks(Vector2Int square, U64 occupancy)
+{
+	return getRayAttacks(square, Vector2Int{ 1, 0 }, occupancy)
+		| getRayAttacks(square, Vector2Int{ -1, 0 }, occupancy)
+		| getRayAttacks(square, Vector2Int{ 0, 1 }, occupancy)
+		| getRayAttacks(square, Vector2Int{ 0, -1 }, occupancy);
+}
+
+U64 Board::getBishopAttacks(Vector2Int square, U64 occupancy)
+{
+	return getRayAttacks(square, Vector2Int{ 1, 1 }, occupancy)
+		| getRayAttacks(square, Vector2Int{ 1, -1 }, occupancy)
+		| getRayAttacks(square, Vector2Int{ -1, 1 }, occupancy)
+		| getRayAttacks(square, Vector2Int{ -1, -1 }, occupancy);
+}
+
+// squares from square in the given direction, up to the edge or the first occupied square (included)
+U64 Board::getRayAttacks(Vector2Int square, Vector2Int direction, U64 occupancy)
+{
+	U64 attacks = 0ull;
+
+	Vector2Int current = Vector2Int{ square.x + direction.x, square.y + direction.y };
+	while (current.x >= 0 && current.x < 8 && current.y >= 0 && current.y < 8) {
+		U64 squareMask = static_cast<U64>(1) << (current.x + current.y * 8);
+		attacks |= squareMask;
+		if (occupancy & squareMask) {
+			break;
+		}
+		current = Vector2Int{ current.x + direction.x, current.y + direction.y };
+	}
+
+	return attacks;
+}
+
+U64 Board::getAttackersTo(Vector2Int square, U64 occupancy, const BoardState& workingState)
+{
+	return (getAttackersTo<White>(square, occupancy, workingState)
+		| getAttackersTo<Black>(square, occupancy, workingState)) & occupancy;
+}
+
+// the usual values, the exchanges only need the order of the pieces to be right
+static int seeValue(char piece)
+{
+	switch (tolower(piece)) {
+	case 'p':
+		return 100;
+	case 'n':
+	case 'b':
+		return 300;
+	case 'r':
+		return 500;
+	case 'q':
+		return 900;
+	case 'k':
+		return 20000;
+	default:
+		return 0;
+	}
+}
+
+// least valuable first
+static const array<char, 6> whiteSEEOrder = { 'P', 'N', 'B', 'R', 'Q', 'K' };
+static const array<char, 6> blackSEEOrder = { 'p', 'n', 'b', 'r', 'q', 'k' };
+
+// swap algorithm, https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm
+int Board::see(Move move, const BoardState& workingState)
+{
+	char attacker = workingState.mailbox[move.from.x + move.from.y * 8];
+	char victim = workingState.mailbox[move.to.x + move.to.y * 8];
+	U64 occupancy = getOccupancy(workingState);
+
+	if (!victim && tolower(attacker) == 'p' && move.to == workingState.enPassant) {
+		// the captured pawn is behind the target square
+		victim = isupper(attacker) ? 'p' : 'P';
+		occupancy &= ~getMaskBitBoard(Vector2Int{ move.to.x, move.from.y });
+	}
+
+	// gains[i] is the material balance for the side making capture i if the exchange stops there
+	int gains[32];
+	int depth = 0;
+	gains[0] = seeValue(victim);
+
+	U64 fromMask = getMaskBitBoard(move.from);
+	bool whiteCaptures = isupper(attacker);
+	while (fromMask && depth < 31) {
+		depth++;
+		gains[depth] = seeValue(attacker) - gains[depth - 1];
+		// neither side can do better than stopping here
+		if (max(-gains[depth - 1], gains[depth]) < 0) {
+			break;
+		}
+
+		// removing the capturing piece uncovers the sliders behind it
+		occupancy &= ~fromMask;
+		U64 attackers = getAttackersTo(move.to, occupancy, workingState);
+
+		whiteCaptures = !whiteCaptures;
+		fromMask = 0ull;
+		for (char piece : whiteCaptures ? whiteSEEOrder : blackSEEOrder) {
+			U64 candidates = attackers & workingState.piecesBitmaps[piece];
+			if (candidates) {
+				fromMask = candidates & (~candidates + 1);
+				attacker = piece;
+				break;
+			}
+		}
+	}
+
+	while (--depth) {
+		gains[depth - 1] = -max(-gains[depth - 1], gains[depth]);
+	}
+	return gains[0];
+}
+
+U64 Board::getOccupancy(const BoardState& workingState)
+{
+	U64 occupancy = 0ull;
+	for (const auto& [piece, bitBoard] : workingState.piecesBitmaps) {
+		occupancy |= bitBoard;
+	}
+	return occupancy;
+}
+
+U64 Board::getCaptureTargets(const BoardState& workingState)
+{
+	U64 targets = getMaskBitBoard(workingState.enPassant);
+	for (const auto& [piece, bitBoard] : workingState.piecesBitmaps) {
+		if (bool(isupper(piece)) != workingState.WToMove) {
+			targets |= bitBoard;
+		}
+	}
+	return targets;
+}
+
 
 
 U64 Board::removeOverLaps(U64 A, U64 B)
@@ -519,13 +1207,14 @@ U64 Board::removeOverLaps(U64 A, U64 B)
 	return A - overlaps;
 }
 
-U64 Board::removeAllies(U64 mask, vector<char> allies)
+template <Side S>
+U64 Board::removeAllies(U64 mask, const BoardState& workingState)
 {
 	U64 finalMask = mask;
 	
 	// remove squares that are occupied by allied pieces.
-	for (int i = 0; i < allies.size(); i++) {
-		finalMask = removeOverLaps(finalMask, state.piecesBitmaps[allies[i]]);
+	for (char ally : SideTraits<S>::allies) {
+		finalMask = removeOverLaps(finalMask, workingState.piecesBitmaps[ally]);
 	}
 	return finalMask;
 }
@@ -557,60 +1246,109 @@ U64 Board::columnMask(int column) {
 
 char Board::whatIsOnSquare(Vector2Int square)
 {
-	return whatIsOnSquare(square, pieces, state);
+	return whatIsOnSquare(square, state);
 }
 
-char Board::whatIsOnSquare(Vector2Int square, vector<char> SelectedPieces)
+char Board::whatIsOnSquare(Vector2Int square, const vector<char>& SelectedPieces)
 {
 	return whatIsOnSquare(square, SelectedPieces, state);
 }
 
-char Board::whatIsOnSquare(Vector2Int square, const vector<char> SelectedPieces, BoardState currentState)
+char Board::whatIsOnSquare(Vector2Int square, const vector<char>& SelectedPieces, const BoardState& currentState)
 {
-	char piece = 0;
-	U64 fromBitBoardMask = getMaskBitBoard(square);
+	char piece = whatIsOnSquare(square, currentState);
 
 	for (int i = 0; i < SelectedPieces.size(); i++) {
-		if (currentState.piecesBitmaps[SelectedPieces[i]] & fromBitBoardMask) {
-			piece = SelectedPieces[i];
-			break;
+		if (SelectedPieces[i] == piece) {
+			return piece;
 		}
 	}
 
-	return piece;
+	return 0;
 }
 
-char Board::whatIsOnSquare(Vector2Int square,  BoardState currentState)
+char Board::whatIsOnSquare(Vector2Int square, const BoardState& currentState)
 {
-	return whatIsOnSquare(square, pieces, currentState);
+	if (square.x < 0 || square.y < 0 || square.x > 7 || square.y > 7) {
+		return 0;
+	}
+	return currentState.mailbox[square.x + square.y * 8];
+}
+
+template <Side S>
+char Board::whatIsOnSquareOf(Vector2Int square, const BoardState& currentState)
+{
+	char piece = whatIsOnSquare(square, currentState);
+	if (piece && bool(isupper(piece)) == SideTraits<S>::isWhite) {
+		return piece;
+	}
+	return 0;
 }
 
 
 void Board::removePiece(Vector2Int square, char piece) {
-	// TODO make a version with previous and new state variable
-	U64 removeMask = ~getMaskBitBoard(square); 
-	state.piecesBitmaps[piece] &= removeMask;
+	removePiece(square, piece, state);
 }
 
-BoardState Board::removePiece(Vector2Int square, char piece, BoardState oldState)
+void Board::removePiece(Vector2Int square, char piece, BoardState& oldState)
 {
 	U64 removeMask = ~getMaskBitBoard(square);
 	oldState.piecesBitmaps[piece] &= removeMask;
-	return oldState;
+	if (oldState.mailbox[square.x + square.y * 8] == piece) {
+		oldState.mailbox[square.x + square.y * 8] = 0;
+		oldState.hash ^= zobrist.pieces[pieceIndex(piece)][square.x + square.y * 8];
+	}
+	oldState.attackInfoValid = false;
 }
 
 
 void Board::addPiece(Vector2Int square, char piece) {
-	// TODO make a version with previous and new state variable
-	U64 addMask = getMaskBitBoard(square);
-	state.piecesBitmaps[piece] |= addMask;
+	addPiece(square, piece, state);
 }
 
-BoardState Board::addPiece(Vector2Int square, char piece, BoardState oldState)
+void Board::addPiece(Vector2Int square, char piece, BoardState& oldState)
 {
 	U64 addMask = getMaskBitBoard(square);
 	oldState.piecesBitmaps[piece] |= addMask;
-	return oldState;
+	oldState.mailbox[square.x + square.y * 8] = piece;
+	oldState.hash ^= zobrist.pieces[pieceIndex(piece)][square.x + square.y * 8];
+	oldState.attackInfoValid = false;
+}
+
+U64 Board::computeHash(const BoardState& currentState)
+{
+	U64 hash = 0ull;
+	for (int square = 0; square < 64; square++) {
+		if (currentState.mailbox[square]) {
+			hash ^= zobrist.pieces[pieceIndex(currentState.mailbox[square])][square];
+		}
+	}
+	if (currentState.WToMove) {
+		hash ^= zobrist.WToMove;
+	}
+	if (currentState.enPassant.x != -1) {
+		hash ^= zobrist.enPassantColumn[currentState.enPassant.x];
+	}
+	return hash;
+}
+
+// throws if the mailbox and the bitboards disagree, only called in debug builds
+void Board::checkMailbox(const BoardState& currentState)
+{
+	for (int square = 0; square < 64; square++) {
+		char expected = 0;
+		for (char piece : pieces) {
+			if (currentState.piecesBitmaps[piece] & static_cast<U64>(1) << square) {
+				if (expected) {
+					throw std::runtime_error("two pieces on the same square in the bitboards");
+				}
+				expected = piece;
+			}
+		}
+		if (currentState.mailbox[square] != expected) {
+			throw std::runtime_error("the mailbox is out of sync with the bitboards");
+		}
+	}
 }
 
 
@@ -643,16 +1381,6 @@ void Board::print(Vector2Int vect)
 	cout << "(x, y) = (" << vect.x << ", " << vect.y << ")" << endl;
 }
 
-vector<char> Board::getAllies(bool isWhite)
-{
-	if (isWhite) {
-		return WPieces;
-	}
-	else {
-		return BPieces;
-	}
-}
-
 vector<Vector2Int> Board::getAllPosInBitBoard(U64 bitBoard)
 {
 	vector<Vector2Int> allPos = vector<Vector2Int>();
@@ -729,6 +1457,16 @@ std::map<char, Texture> Board::LoadPiecesImages() {
 }
 
 
+// the half move clock and the full move counter, stoi would accept "12abc" and throw
+// other exceptions than the rest of ReadFEN
+static unsigned int readFENClock(const string& field)
+{
+	if (field.empty() || field.length() > 6 || field.find_first_not_of("0123456789") != string::npos) {
+		throw std::runtime_error("invalid move counter in FEN notation");
+	}
+	return unsigned(stoi(field));
+}
+
 /*
 Uses the structure of the FEN notation : https://www.chessprogramming.org/Forsyth-Edwards_Notation
 
@@ -740,6 +1478,17 @@ BoardState Board::ReadFEN(std::string FENState) {
 	BoardState boardState = BoardState{};
 	string remainingFEN = FENState;
 
+	// a missing field would be read again from the previous one
+	stringstream fields(FENState);
+	string field;
+	int fieldCount = 0;
+	while (fields >> field) {
+		fieldCount++;
+	}
+	if (fieldCount != 6) {
+		throw std::runtime_error("FEN notation needs 6 fields");
+	}
+
 	string delimiter = " ";
 	string piecesPos = remainingFEN.substr(0, remainingFEN.find(delimiter));
 	//std::cout << piecesPos << "\n";
@@ -775,16 +1524,33 @@ BoardState Board::ReadFEN(std::string FENState) {
 			// std::cout << piecesPos[i];
 			// std::cout << "\n";
 			col += piecesPos[i] - '0';
+			if (col > 8) {
+				throw std::runtime_error("more than 8 squares in a rank in FEN notation");
+			}
 		}
 		else if (piecesPos[i] == '/') {
+			// every rank is complete, so the squares always stay on the board
+			if (col != 8 || row == 7) {
+				throw std::runtime_error("invalid ranks in FEN notation");
+			}
 			row += 1;
 			col = 0;
 		}
 		else {
+			if (find(pieces.begin(), pieces.end(), piecesPos[i]) == pieces.end()) {
+				throw std::runtime_error("invalid piece in FEN notation");
+			}
+			if (col >= 8) {
+				throw std::runtime_error("more than 8 squares in a rank in FEN notation");
+			}
 			boardState.piecesBitmaps[piecesPos[i]] |= static_cast<U64>(1) << (col + row * 8);
+			boardState.mailbox[col + row * 8] = piecesPos[i];
 			col += 1;
 		}
 	};
+	if (row != 7 || col != 8) {
+		throw std::runtime_error("the board is not 64 squares in FEN notation");
+	}
 
 	// std::cout << std::bitset<64>(boardState.piecesBitmaps['p']) << '\n';
 
@@ -797,24 +1563,99 @@ BoardState Board::ReadFEN(std::string FENState) {
 		boardState.WToMove = false;
 	}
 	else {
-		cout << "invalid side to move in FEN notation \n";
+		throw std::runtime_error("invalid side to move in FEN notation");
 	}
 
 	// TODO castling
 
-	// TODO En passant letter -> col and number -> row
-	// then use static_cast<U64>(1) << (col+ row * 8)
-	// if row = 3 => Black En passant else WEnPassant
+	// the square behind the pawn that just moved two squares, the hash indexes its column
 	boardState.enPassant = Vector2Int{ -1, -1 };
+	if (enPassant != "-") {
+		char rank = boardState.WToMove ? '6' : '3';
+		if (enPassant.length() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' || enPassant[1] != rank) {
+			throw std::runtime_error("invalid en passant square in FEN notation");
+		}
+		boardState.enPassant = Vector2Int{ enPassant[0] - 'a', '8' - enPassant[1] };
+	}
 
-	// TODO halfTurn Clock
+	boardState.halfMoveClock = readFENClock(HalfMoveClock);
+	boardState.turn = readFENClock(FullMoveClock);
 
-	boardState.turn = stoi(FullMoveClock);
+	// the move generation, the engine and the drawing all expect both kings
+	if (bitset<64>(boardState.piecesBitmaps['K']).count() != 1 || bitset<64>(boardState.piecesBitmaps['k']).count() != 1) {
+		throw std::runtime_error("there must be one king per side in FEN notation");
+	}
+
+	boardState.hash = computeHash(boardState);
+
+#ifndef NDEBUG
+	checkMailbox(boardState);
+#endif
 
 	return boardState;
 };
 
+void pushHistory(PositionHistory& history, U64 hash)
+{
+	history.hashes[history.count % HISTORY_SIZE] = hash;
+	history.count++;
+}
+
+void popHistory(PositionHistory& history)
+{
+	history.count--;
+}
+
+int countRepetitions(const PositionHistory& history, const BoardState& position)
+{
+	if (history.count == 0) {
+		return 0;
+	}
+
+	int repetitions = 0;
+	// no position before the last capture or pawn move can come back
+	unsigned int reversiblePlies = min(position.halfMoveClock, history.count - 1);
+	reversiblePlies = min(reversiblePlies, (unsigned int)(HISTORY_SIZE - 1));
+
+	// the same side has to be to move, so only every other ply
+	for (unsigned int ply = 0; ply <= reversiblePlies; ply += 2) {
+		if (history.hashes[(history.count - 1 - ply) % HISTORY_SIZE] == position.hash) {
+			repetitions++;
+		}
+	}
+	return repetitions;
+}
+
 bool operator==(const Vector2Int& lhs, const Vector2Int& rhs)
 {
 	return lhs.x == rhs.x && lhs.y == rhs.y;
 }
+
+bool operator==(const Move& lhs, const Move& rhs)
+{
+	return lhs.from == rhs.from && lhs.to == rhs.to;
+}
+
+string moveToString(Move move)
+{
+	string text = "0000";
+	text[0] = char('a' + move.from.x);
+	text[1] = char('8' - move.from.y);
+	text[2] = char('a' + move.to.x);
+	text[3] = char('8' - move.to.y);
+	return text;
+}
+
+Move moveFromString(const string& text)
+{
+	// the pawns always become queens, so the only promotion piece accepted is a queen
+	if (text.length() < 4 || text.length() > 5 || (text.length() == 5 && text[4] != 'q')) {
+		return Move{ {-1, -1}, {-1, -1} };
+	}
+	Move move = Move{ { text[0] - 'a', '8' - text[1] }, { text[2] - 'a', '8' - text[3] } };
+	if (move.from.x < 0 || move.from.x > 7 || move.from.y < 0 || move.from.y > 7
+		|| move.to.x < 0 || move.to.x > 7 || move.to.y < 0 || move.to.y > 7) {
+		return Move{ {-1, -1}, {-1, -1} };
+	}
+	return move;
+}
@@ -7,9 +7,27 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <array>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 typedef unsigned long long U64;
 
+// index (x + y * 8) of the lowest square set, the bit board can't be empty
+inline int lowestSquare(U64 bitBoard)
+{
+#ifdef _MSC_VER
+	unsigned long square;
+	_BitScanForward64(&square, bitBoard);
+	return int(square);
+#else
+	return __builtin_ctzll(bitBoard);
+#endif
+}
+
 using namespace std;
 
 struct Vector2Int {
@@ -19,10 +37,113 @@ struct Vector2Int {
 
 bool operator==(const Vector2Int& lhs, const Vector2Int& rhs);
 
+struct Move {
+	Vector2Int from;
+	Vector2Int to;
+};
+
+bool operator==(const Move& lhs, const Move& rhs);
+
+// more than the legal moves of any position
+#define MAX_MOVES 256
+
+// the moves of a position, in place so that generating them allocates nothing
+typedef struct MoveList {
+	Move moves[MAX_MOVES];
+	int count = 0;
+
+	void push(Move move) { moves[count++] = move; }
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	void clear() { count = 0; }
+	Move& operator[](int i) { return moves[i]; }
+	const Move* begin() const { return moves; }
+	const Move* end() const { return moves + count; }
+} MoveList;
+// coordinate notation, like "e2e4"
+string moveToString(Move move);
+// {-1, -1} {-1, -1} if the text is not a move
+Move moveFromString(const string& text);
+
+
+enum Side {
+	White,
+	Black
+};
+
+// everything that depends on the colour, known at compile time so that the
+// move generation is compiled once for each side without colour branches
+template <Side S>
+struct SideTraits {
+	static constexpr bool isWhite = S == White;
+	static constexpr Side opponent = isWhite ? Black : White;
+
+	// white starts on the bottom rows (6 and 7) and goes up
+	static constexpr int pawnDirection = isWhite ? -1 : 1;
+	static constexpr int pawnHomeRow = isWhite ? 6 : 1;
+	static constexpr int promotionRow = isWhite ? 0 : 7;
+
+	static constexpr char king = isWhite ? 'K' : 'k';
+	static constexpr char queen = isWhite ? 'Q' : 'q';
+	static constexpr char bishop = isWhite ? 'B' : 'b';
+	static constexpr char knight = isWhite ? 'N' : 'n';
+	static constexpr char rook = isWhite ? 'R' : 'r';
+	static constexpr char pawn = isWhite ? 'P' : 'p';
+	static constexpr std::array<char, 6> allies = { king, queen, bishop, knight, rook, pawn };
+};
+
+
+// same order as Board::pieces
+inline int pieceIndex(char piece)
+{
+	switch (piece) {
+	case 'K': return 0;
+	case 'Q': return 1;
+	case 'B': return 2;
+	case 'N': return 3;
+	case 'R': return 4;
+	case 'P': return 5;
+	case 'k': return 6;
+	case 'q': return 7;
+	case 'b': return 8;
+	case 'n': return 9;
+	case 'r': return 10;
+	default: return 11;
+	}
+}
+
+// the bit board of each piece, used like a map<char, U64> but copied without allocating
+typedef struct PieceBitBoards {
+	std::array<std::pair<char, U64>, 12> bitBoards = { {
+		{'K', 0}, {'Q', 0}, {'B', 0}, {'N', 0}, {'R', 0}, {'P', 0},
+		{'k', 0}, {'q', 0}, {'b', 0}, {'n', 0}, {'r', 0}, {'p', 0} } };
+
+	U64& operator[](char piece) { return bitBoards[pieceIndex(piece)].second; }
+	U64 operator[](char piece) const { return bitBoards[pieceIndex(piece)].second; }
+	auto begin() { return bitBoards.begin(); }
+	auto end() { return bitBoards.end(); }
+	auto begin() const { return bitBoards.begin(); }
+	auto end() const { return bitBoards.end(); }
+} PieceBitBoards;
+
 
 typedef struct BoardState {
-	// keys are contained in pieces
-	map<char, U64> piecesBitmaps;
+	PieceBitBoards piecesBitmaps;
+	// the piece on each square (x + y * 8), 0 if empty. Kept in sync with piecesBitmaps
+	// by addPiece and removePiece.
+	uint8_t mailbox[64];
+
+	// attack information of the position, computed lazily by Board::updateAttackInfo
+	// and reset by any change to the pieces
+	bool attackInfoValid;
+	U64 attackedBy[2]; // indexed by Side, the sliders see through the enemy king
+	U64 checkers; // enemy pieces giving check to the side to move
+	U64 pinned; // pieces of the side to move pinned on their king
+
+	// Zobrist hash of the pieces, the side to move and the en passant column
+	U64 hash;
+	// plies since the last capture or pawn move, for the 50 move rule
+	unsigned int halfMoveClock;
 	bool WToMove;
 	unsigned int turn;
 	Vector2Int enPassant;
@@ -30,8 +151,48 @@ typedef struct BoardState {
 } BoardState;
 
 
+// a position in 32 bytes, for keeping a lot of them around (servers, logs, training data).
+// The attack information is dropped and the hash is recomputed when unpacking.
+typedef struct PackedPosition {
+	U64 occupancy;
+	// index in Board::pieces of each piece, 4 bits each, in the order of the occupied squares
+	uint8_t pieces[16];
+	// bit 0 : white to move, bits 1 to 4 : en passant column + 1, 0 if none
+	uint8_t flags;
+	uint8_t halfMoveClock;
+	uint16_t turn;
+	uint8_t unused[4];
+} PackedPosition;
+
+
+// only the last plies can be repeated, nothing goes back further than the 50 move rule
+#define HISTORY_SIZE 256
+
+// hashes of the positions of a game, the last one being the current position
+typedef struct PositionHistory {
+	U64 hashes[HISTORY_SIZE]; // ring buffer
+	unsigned int count;
+} PositionHistory;
+
+void pushHistory(PositionHistory& history, U64 hash);
+void popHistory(PositionHistory& history);
+// how many times the position was reached, only looking at the plies since the last irreversible move
+int countRepetitions(const PositionHistory& history, const BoardState& position);
+
+
+enum GameStatus {
+	Ongoing,
+	Checkmate, // the side to move lost
+	Stalemate,
+	ThreefoldRepetition,
+	FiftyMoveRule
+};
+
+
 
 class Board {
+	// the microbenchmarks in bench/ time the private primitives directly
+	friend class BoardBench;
 private:
 	struct Color whiteColor;
 	struct Color blackColor;
@@ -48,53 +209,84 @@ private:
 
 	// interactions
 	Vector2Int squareSelected;
+	PositionHistory history;
+	GameStatus gameStatus;
+
+	// times updateAttackInfo had to compute, the bench checks that no position is done twice
+	unsigned long long attackInfoComputations;
 
 	void drawSquare(int posx, int posy, struct Color squareColor);
-	BoardState ReadFEN(std::string FENState);
 	std::map<char, Texture> LoadPiecesImages();
 
 	void drawBitBoard(Color, U64, Texture = Texture{});
 	// returns true if the move was valid
 	bool safeMovePiece(Vector2Int from, Vector2Int to);
-	BoardState movePiece(Vector2Int from, Vector2Int to, BoardState previousState);
+	BoardState movePiece(Vector2Int from, Vector2Int to, const BoardState& previousState);
+	template <Side S> BoardState movePiece(Vector2Int from, Vector2Int to, const BoardState& previousState);
+	// only the moves landing on targets
+	template <Side S> void getLegalMoves(BoardState& workingState, U64 targets, MoveList& moves);
+	template <Side S> BoardState makeMove(Move move, const BoardState& workingState);
+	template <Side S> bool hasLegalMove(BoardState& workingState);
 
 	U64 getMaskBitBoard(Vector2Int); 
 
-	U64 getAttacksBitBoard(Vector2Int square, char piece, BoardState workingState);
-	U64 getValidMovesBitBoard(Vector2Int square, char piece, BoardState workingState);
-	U64 getValidMovesBitBoardKnight(Vector2Int square, BoardState workingState);
-	U64 getValidMovesBitBoardPawn(Vector2Int square, bool isWhite, BoardState workingState);
-	U64 getValidAttacksPawn(Vector2Int square, bool isWhite, BoardState workingState);
-	U64 getValidMovesBitBoardRook(Vector2Int square, BoardState workingState);
-	U64 getValidMovesBitBoardBishop(Vector2Int square, BoardState workingState);
-	U64 getValidMovesBitBoardQueen(Vector2Int square, BoardState workingState);
-	U64 getValidMovesBitBoardKing(Vector2Int square, BoardState workingState);
+	template <Side S> U64 getAttacksBitBoard(Vector2Int square, char piece, const BoardState& workingState);
+	U64 getValidMovesBitBoard(Vector2Int square, char piece, BoardState& workingState);
+	// fills the attack information of workingState
+	template <Side S> U64 getValidMovesBitBoard(Vector2Int square, char piece, BoardState& workingState, U64 targets = ~0ull);
+	U64 getValidMovesBitBoardKnight(Vector2Int square, const BoardState& workingState);
+	U64 getValidMovesBitBoardPawn(Vector2Int square, bool isWhite, const BoardState& workingState);
+	template <Side S> U64 getValidMovesBitBoardPawn(Vector2Int square, const BoardState& workingState);
+	template <Side S> U64 getValidAttacksPawn(Vector2Int square, const BoardState& workingState);
+	U64 getValidMovesBitBoardRook(Vector2Int square, const BoardState& workingState);
+	U64 getValidMovesBitBoardBishop(Vector2Int square, const BoardState& workingState);
+	U64 getValidMovesBitBoardQueen(Vector2Int square, const BoardState& workingState);
+	U64 getValidMovesBitBoardKing(Vector2Int square, const BoardState& workingState);
 
 	U64 shiftMask(U64, Vector2Int);
 
-	U64 getAttackedSquaresBy(bool isWhite, BoardState positions);
-	bool isInCheckBy(bool isWhite, BoardState positions);
-	U64 removeChecksFromPossibleMoves(U64 possibleMoves, Vector2Int square, char piece);
+	U64 getAttackedSquaresBy(bool isWhite, const BoardState& positions);
+	template <Side S> U64 getAttackedSquaresBy(const BoardState& positions);
+	template <Side S> bool isInCheckBy(const BoardState& positions);
+	template <Side S> U64 removeChecksFromPossibleMoves(U64 possibleMoves, Vector2Int square, char piece, BoardState& workingState);
+
+	// fills the attack information of the position if it is not there yet
+	void updateAttackInfo(BoardState& workingState);
+	template <Side S> void computeAttackInfo(BoardState& workingState);
+	template <Side S> U64 getAllAttacks(U64 occupancy, const BoardState& workingState);
+	template <Side S> U64 getAttackersTo(Vector2Int square, U64 occupancy, const BoardState& workingState);
+	template <Side S> U64 getPinnedPieces(Vector2Int kingSquare, const BoardState& workingState);
+	template <Side S> U64 getPawnAttacks(Vector2Int square);
+	U64 getRookAttacks(Vector2Int square, U64 occupancy);
+	U64 getBishopAttacks(Vector2Int square, U64 occupancy);
+	U64 getRayAttacks(Vector2Int square, Vector2Int direction, U64 occupancy);
+	U64 getOccupancy(const BoardState& workingState);
+	// enemy pieces and the en passant square
+	U64 getCaptureTargets(const BoardState& workingState);
 
 	// remove from A all squares in B
 	U64 removeOverLaps(U64 A, U64 B);
-	U64 removeAllies(U64 mask, vector<char> allies);
+	template <Side S> U64 removeAllies(U64 mask, const BoardState& workingState);
 	U64 lineMask(int line);
 	U64 columnMask(int column);
 	// return 0 if nothing is on the square
 	char whatIsOnSquare(Vector2Int);
-	char whatIsOnSquare(Vector2Int, const vector<char>);
-	char whatIsOnSquare(Vector2Int, const vector<char>, BoardState);
-	char whatIsOnSquare(Vector2Int, BoardState);
+	char whatIsOnSquare(Vector2Int, const vector<char>&);
+	char whatIsOnSquare(Vector2Int, const vector<char>&, const BoardState&);
+	// only looks at the pieces of side S
+	template <Side S> char whatIsOnSquareOf(Vector2Int, const BoardState&);
 	void removePiece(Vector2Int, char);
-	BoardState removePiece(Vector2Int, char, BoardState);
+	// in place, for the copy-make of movePiece
+	void removePiece(Vector2Int, char, BoardState&);
 	void addPiece(Vector2Int, char);
-	BoardState addPiece(Vector2Int, char, BoardState);
+	void addPiece(Vector2Int, char, BoardState&);
+	void checkMailbox(const BoardState&);
+	U64 computeHash(const BoardState&);
 	Vector2Int processClick(int, int);
 	void print(U64);
 	void print(Vector2Int);
 
-	vector<char> getAllies(bool isWhite);
+	// allocates, the move generation walks the bits with lowestSquare instead
 	vector<Vector2Int> getAllPosInBitBoard(U64 bitBoard);
 
 
@@ -106,6 +298,48 @@ public:
 		int newBoardSize,
 		struct Vector2 newPos,
 		std::string startingFENState);// using FEN notation https://www.chessprogramming.org/Forsyth-Edwards_Notation
+	// headless board : no textures are loaded so no window is needed
+	Board(std::string startingFENState);
+
+	// headless interface, used by the engine and the tools. The functions taking a BoardState&
+	// fill its attack information, the next calls on the same state reuse it
+	BoardState getState();
+	// throws a runtime_error if the FEN is not a valid position
+	BoardState ReadFEN(std::string FENState);
+	vector<Move> getLegalMoves(BoardState& workingState);
+	// the same moves in a list owned by the caller, the search and perft don't allocate
+	void getLegalMoves(BoardState& workingState, MoveList& moves);
+	// the same moves split in two, for the search to generate the captures first
+	void getLegalCaptures(BoardState& workingState, MoveList& moves);
+	void getLegalQuietMoves(BoardState& workingState, MoveList& moves);
+	// for moves that don't come from the move generation, like the ones remembered by the search
+	bool isLegalMove(Move move, BoardState& workingState);
+	// any move to the en passant square counts as a capture
+	bool isCapture(Move move, const BoardState& workingState);
+	// pieces of both sides attacking the square, the sliders see through the squares missing from occupancy
+	U64 getAttackersTo(Vector2Int square, U64 occupancy, const BoardState& workingState);
+	// static exchange evaluation : what the side to move wins, in centipawns, by playing the capture and
+	// then recapturing on the square with the least valuable piece for as long as it pays off
+	int see(Move move, const BoardState& workingState);
+	// return 0 if nothing is on the square
+	char whatIsOnSquare(Vector2Int, const BoardState&);
+	PackedPosition packPosition(const BoardState& workingState);
+	// throws a runtime_error for more than 32 pieces, a piece index or an en passant column out of range
+	BoardState unpackPosition(const PackedPosition& packed);
+	// the castling rights are always "-"
+	string getFEN(const BoardState& workingState);
+	// plays a move from getLegalMoves and gives the turn to the other side
+	BoardState makeMove(Move move, const BoardState& workingState);
+	// is the side to move in check
+	bool isInCheck(const BoardState& workingState);
+	// squares attacked by the pieces of side, the sliders see through the enemy king
+	U64 getAttackedSquares(Side side, BoardState& workingState);
+	U64 perft(BoardState workingState, int depth);
+	// stops at the first legal move found
+	bool hasLegalMove(BoardState& workingState);
+	// the history has to end with workingState
+	GameStatus getGameStatus(BoardState& workingState, const PositionHistory& positionHistory);
+
 	void drawBoard();
 	void onMouseClick();
 	bool gameOver;
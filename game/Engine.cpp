@@ -0,0 +1,347 @@
+#include "Engine.h"
+#include <bitset>
+#include <algorithm>
+
+using namespace std;
+
+
+EngineConfig defaultEngineConfig()
+{
+	EngineConfig config = EngineConfig{};
+	config.maxDepth = 0;
+	config.maxNodes = 0;
+	config.maxTimeMs = 0;
+	config.pawnValue = 100;
+	config.knightValue = 300;
+	config.bishopValue = 320;
+	config.rookValue = 500;
+	config.queenValue = 900;
+	return config;
+}
+
+
+Engine::Engine(EngineConfig newConfig)
+	: rules("4k3/8/8/8/8/8/8/4K3 w - - 0 1") {
+	config = newConfig;
+	nodes = 0;
+	stopped = false;
+	hashMoves = vector<HashMoveEntry>(HASH_MOVES_SIZE, HashMoveEntry{ 0, noMove });
+	pickerBuffers = vector<PickerBuffer>(MAX_PLY);
+	fill(&historyScores[0][0][0], &historyScores[0][0][0] + 2 * 64 * 64, 0);
+}
+
+/*
+Iterative deepening : searches depth 1, 2, 3, ... until one of the limits is hit.
+The move of the last depth that was searched completely is returned, searching the
+previous best move first so that an interrupted depth can't make things worse.
+*/
+SearchResult Engine::search(BoardState position)
+{
+	PositionHistory gameHistory = PositionHistory{};
+	pushHistory(gameHistory, position.hash);
+	return search(position, gameHistory);
+}
+
+SearchResult Engine::search(BoardState position, const PositionHistory& gameHistory)
+{
+	history = gameHistory;
+	nodes = 0;
+	stopped = false;
+	searchStart = chrono::steady_clock::now();
+
+	// the killers and counter moves belong to the previous position, the history is only aged
+	fill(&killers[0][0], &killers[0][0] + MAX_PLY * 2, noMove);
+	fill(&counterMoves[0][0], &counterMoves[0][0] + 64 * 64, noMove);
+	for (int* score = &historyScores[0][0][0]; score != &historyScores[0][0][0] + 2 * 64 * 64; score++) {
+		*score /= 2;
+	}
+	fill(cutoffs, cutoffs + PICKER_STAGES, 0ull);
+
+	SearchResult result = SearchResult{};
+	result.bestMove = noMove;
+
+	MoveList rootMoves;
+	rules.getLegalMoves(position, rootMoves);
+	if (rootMoves.empty()) {
+		result.score = rules.isInCheck(position) ? -MATE_SCORE : 0;
+		return result;
+	}
+	result.bestMove = rootMoves[0];
+
+	// without any limit only search to depth 1
+	int maxDepth = config.maxDepth;
+	if (maxDepth == 0) {
+		maxDepth = (config.maxNodes || config.maxTimeMs) ? 64 : 1;
+	}
+
+	for (int depth = 1; depth <= maxDepth; depth++) {
+		int alpha = -INFINITE_SCORE;
+		int beta = INFINITE_SCORE;
+		Move bestMove = rootMoves[0];
+
+		for (const Move& move : rootMoves) {
+			BoardState child = rules.makeMove(move, position);
+			pushHistory(history, child.hash);
+			int score = -negamax(child, depth - 1, -beta, -alpha, 1, move);
+			popHistory(history);
+			if (stopped) {
+				break;
+			}
+			if (score > alpha) {
+				alpha = score;
+				bestMove = move;
+			}
+		}
+
+		if (stopped) {
+			break;
+		}
+
+		result.bestMove = bestMove;
+		result.score = alpha;
+		result.depth = depth;
+
+		// search the best move first at the next depth
+		for (int i = 0; i < rootMoves.size(); i++) {
+			if (rootMoves[i].from == bestMove.from && rootMoves[i].to == bestMove.to) {
+				swap(rootMoves[0], rootMoves[i]);
+				break;
+			}
+		}
+
+		// no need to go deeper once a mate was found
+		if (abs(alpha) >= MATE_SCORE - 64) {
+			break;
+		}
+	}
+
+	result.nodes = nodes;
+	copy(cutoffs, cutoffs + PICKER_STAGES, result.cutoffs);
+	return result;
+}
+
+int Engine::negamax(BoardState position, int depth, int alpha, int beta, int ply, Move previousMove)
+{
+	nodes++;
+	if (shouldStop()) {
+		return 0;
+	}
+
+	// one repetition is enough inside the tree, if it is good for one side it will play it again
+	if (position.halfMoveClock >= 100 || countRepetitions(history, position) >= 2) {
+		return 0;
+	}
+
+	if (depth == 0) {
+		return quiescence(position, alpha, beta, ply);
+	}
+	// no picker left for a deeper ply
+	if (ply >= MAX_PLY) {
+		return evaluate(position);
+	}
+
+	Move counterMove = noMove;
+	if (!(previousMove == noMove)) {
+		counterMove = counterMoves[previousMove.from.x + previousMove.from.y * 8][previousMove.to.x + previousMove.to.y * 8];
+	}
+	MovePicker picker = MovePicker(rules, pickerBuffers[ply], position, probeHashMove(position.hash),
+		killers[ply][0], killers[ply][1], counterMove, historyScores[position.WToMove ? White : Black]);
+
+	Move move;
+	Move bestMove = noMove;
+	bool hasMove = false;
+	while (picker.next(move)) {
+		hasMove = true;
+		BoardState child = rules.makeMove(move, position);
+		pushHistory(history, child.hash);
+		int score = -negamax(child, depth - 1, -beta, -alpha, ply + 1, move);
+		popHistory(history);
+		if (stopped) {
+			return 0;
+		}
+		if (score >= beta) {
+			cutoffs[picker.getStage()]++;
+			if (!rules.isCapture(move, position)) {
+				updateQuietStats(move, previousMove, depth, ply, position.WToMove);
+			}
+			storeHashMove(position.hash, move);
+			return beta;
+		}
+		if (score > alpha) {
+			alpha = score;
+			bestMove = move;
+		}
+	}
+
+	if (!hasMove) {
+		// prefer the fastest mate
+		return rules.isInCheck(position) ? -MATE_SCORE + ply : 0;
+	}
+
+	if (!(bestMove == noMove)) {
+		storeHashMove(position.hash, bestMove);
+	}
+	return alpha;
+}
+
+// https://www.chessprogramming.org/Quiescence_Search
+int Engine::quiescence(BoardState position, int alpha, int beta, int ply)
+{
+	nodes++;
+	if (shouldStop()) {
+		return 0;
+	}
+
+	// in check there is no standing pat : every evasion is searched
+	if (rules.isInCheck(position)) {
+		return quiescenceEvasions(position, alpha, beta, ply);
+	}
+
+	// stand pat : the side to move is not forced to capture
+	int standPat = evaluate(position);
+	if (standPat >= beta) {
+		return beta;
+	}
+	// no picker left for a deeper ply
+	if (ply >= MAX_PLY) {
+		return max(alpha, standPat);
+	}
+	// delta pruning : not even a queen would be enough
+	if (standPat + config.queenValue + DELTA_MARGIN < alpha) {
+		return alpha;
+	}
+	if (standPat > alpha) {
+		alpha = standPat;
+	}
+
+	// the picker already leaves out the captures losing material
+	MovePicker picker = MovePicker(rules, pickerBuffers[ply], position);
+	Move move;
+	while (picker.next(move)) {
+		char attacker = position.mailbox[move.from.x + move.from.y * 8];
+		char victim = position.mailbox[move.to.x + move.to.y * 8];
+		bool promotion = tolower(attacker) == 'p' && (move.to.y == 0 || move.to.y == 7);
+		if (!victim && tolower(attacker) == 'p') {
+			victim = 'p'; // en passant
+		}
+		if (!promotion && standPat + pieceValue(victim) + DELTA_MARGIN < alpha) {
+			continue;
+		}
+
+		int score = -quiescence(rules.makeMove(move, position), -beta, -alpha, ply + 1);
+		if (stopped) {
+			return 0;
+		}
+		if (score >= beta) {
+			return beta;
+		}
+		if (score > alpha) {
+			alpha = score;
+		}
+	}
+
+	return alpha;
+}
+
+// the side to move is in check : no stand pat and no delta pruning, the evasions are
+// ordered like in the main search and having none is a mate
+int Engine::quiescenceEvasions(BoardState& position, int alpha, int beta, int ply)
+{
+	// no picker left for a deeper ply
+	if (ply >= MAX_PLY) {
+		return evaluate(position);
+	}
+
+	MovePicker picker = MovePicker(rules, pickerBuffers[ply], position, probeHashMove(position.hash),
+		noMove, noMove, noMove, historyScores[position.WToMove ? White : Black]);
+	Move move;
+	bool hasMove = false;
+	while (picker.next(move)) {
+		hasMove = true;
+		int score = -quiescence(rules.makeMove(move, position), -beta, -alpha, ply + 1);
+		if (stopped) {
+			return 0;
+		}
+		if (score >= beta) {
+			return beta;
+		}
+		if (score > alpha) {
+			alpha = score;
+		}
+	}
+
+	// prefer the fastest mate
+	return hasMove ? alpha : -MATE_SCORE + ply;
+}
+
+Move Engine::probeHashMove(U64 hash)
+{
+	const HashMoveEntry& entry = hashMoves[hash & (HASH_MOVES_SIZE - 1)];
+	return entry.hash == hash ? entry.move : noMove;
+}
+
+void Engine::storeHashMove(U64 hash, Move move)
+{
+	hashMoves[hash & (HASH_MOVES_SIZE - 1)] = HashMoveEntry{ hash, move };
+}
+
+void Engine::updateQuietStats(Move move, Move previousMove, int depth, int ply, bool WToMove)
+{
+	if (!(killers[ply][0] == move)) {
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = move;
+	}
+	if (!(previousMove == noMove)) {
+		counterMoves[previousMove.from.x + previousMove.from.y * 8][previousMove.to.x + previousMove.to.y * 8] = move;
+	}
+	// deeper cutoffs say more about the move
+	historyScores[WToMove ? White : Black][move.from.x + move.from.y * 8][move.to.x + move.to.y * 8] += depth * depth;
+}
+
+bool Engine::shouldStop()
+{
+	if (config.maxNodes && nodes >= config.maxNodes) {
+		stopped = true;
+	}
+	else if (config.maxTimeMs) {
+		auto elapsed = chrono::steady_clock::now() - searchStart;
+		if (chrono::duration_cast<chrono::milliseconds>(elapsed).count() >= config.maxTimeMs) {
+			stopped = true;
+		}
+	}
+	return stopped;
+}
+
+int Engine::evaluate(BoardState position)
+{
+	int score = 0;
+	for (const auto& [piece, bitBoard] : position.piecesBitmaps) {
+		int count = int(bitset<64>(bitBoard).count());
+		if (isupper(piece)) {
+			score += count * pieceValue(piece);
+		}
+		else {
+			score -= count * pieceValue(piece);
+		}
+	}
+	return position.WToMove ? score : -score;
+}
+
+int Engine::pieceValue(char piece)
+{
+	switch (tolower(piece)) {
+	case 'p':
+		return config.pawnValue;
+	case 'n':
+		return config.knightValue;
+	case 'b':
+		return config.bishopValue;
+	case 'r':
+		return config.rookValue;
+	case 'q':
+		return config.queenValue;
+	default:
+		// the kings are always on the board
+		return 0;
+	}
+}
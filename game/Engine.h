@@ -0,0 +1,101 @@
+#pragma once
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "Board.h"
+#include "MovePicker.h"
+#include <chrono>
+
+// the values are in centipawns
+#define MATE_SCORE 100000
+#define INFINITE_SCORE 1000000
+
+#define MAX_PLY 128
+// a capture is skipped in the quiescence search when even winning the victim and this
+// much more can't bring the score back to alpha
+#define DELTA_MARGIN 200
+// entries of the hash move table, a power of 2
+#define HASH_MOVES_SIZE (1 << 16)
+
+
+// a limit set to 0 is not used
+typedef struct EngineConfig {
+	int maxDepth;
+	unsigned long long maxNodes;
+	int maxTimeMs;
+
+	int pawnValue;
+	int knightValue;
+	int bishopValue;
+	int rookValue;
+	int queenValue;
+} EngineConfig;
+
+EngineConfig defaultEngineConfig();
+
+
+typedef struct SearchResult {
+	Move bestMove; // {-1, -1} {-1, -1} if there is no legal move
+	int score; // from the point of view of the side to move
+	int depth; // last fully searched depth
+	unsigned long long nodes;
+	// beta cutoffs counted by the picker stage of the move that caused them
+	unsigned long long cutoffs[PICKER_STAGES];
+} SearchResult;
+
+
+// best move found in a position, the search looks at it first when it comes back there
+typedef struct HashMoveEntry {
+	U64 hash;
+	Move move;
+} HashMoveEntry;
+
+
+// alpha beta search with iterative deepening and a quiescence search, the board is only used for its rules.
+// An engine is used by one thread at a time, everything the search needs is allocated with it.
+class Engine {
+private:
+	Board rules;
+	EngineConfig config;
+
+	unsigned long long nodes;
+	bool stopped;
+	// the game followed by the current line of the search
+	PositionHistory history;
+	std::chrono::steady_clock::time_point searchStart;
+
+	// move ordering, learned while searching
+	vector<HashMoveEntry> hashMoves; // indexed by the low bits of the hash, always replaced
+	Move killers[MAX_PLY][2]; // quiet moves that cut off at the same ply
+	Move counterMoves[64][64]; // quiet move that cut off after a move, indexed by its from and to squares
+	int historyScores[2][64][64]; // indexed by side, from and to squares
+	unsigned long long cutoffs[PICKER_STAGES];
+
+	// the moves of the picker of each ply, allocated once so that searching allocates nothing
+	vector<PickerBuffer> pickerBuffers;
+
+	// previousMove is the move that led to position, noMove at the root
+	int negamax(BoardState position, int depth, int alpha, int beta, int ply, Move previousMove);
+	// only the captures that don't lose material, until the position is quiet
+	int quiescence(BoardState position, int alpha, int beta, int ply);
+	// every legal move when the side to move is in check
+	int quiescenceEvasions(BoardState& position, int alpha, int beta, int ply);
+	bool shouldStop();
+	Move probeHashMove(U64 hash);
+	void storeHashMove(U64 hash, Move move);
+	// rewards a quiet move that caused a cutoff
+	void updateQuietStats(Move move, Move previousMove, int depth, int ply, bool WToMove);
+
+public:
+	Engine(EngineConfig newConfig);
+
+	SearchResult search(BoardState position);
+	// the history has to end with position, it is used to find repetitions
+	SearchResult search(BoardState position, const PositionHistory& gameHistory);
+	// material balance from the point of view of the side to move
+	int evaluate(BoardState position);
+	int pieceValue(char piece);
+};
+
+#endif // !ENGINE_H
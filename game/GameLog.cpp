@@ -0,0 +1,360 @@
+#include "GameLog.h"
+#include <ctype.h>
+#include <cstring>
+
+using namespace std;
+
+
+// any valid position, the board is only used for its rules
+static const string kingsOnlyFEN = "4k3/8/8/8/8/8/8/4K3 w - - 0 1";
+
+// the blocks are padded to 8 bytes so that the next one is aligned
+static size_t getBlockSize(uint16_t moveCount)
+{
+	return (sizeof(GameLogBlock) + moveCount * sizeof(uint16_t) + 7) & ~size_t(7);
+}
+
+uint16_t encodeMove(Move move)
+{
+	return uint16_t((move.from.x + move.from.y * 8) | ((move.to.x + move.to.y * 8) << 6));
+}
+
+Move decodeMove(uint16_t move)
+{
+	int from = move & 63;
+	int to = (move >> 6) & 63;
+	return Move{ { from % 8, from / 8 }, { to % 8, to / 8 } };
+}
+
+
+GameLogWriter::GameLogWriter(string path)
+	: rules(kingsOnlyFEN) {
+	file = nullptr;
+	keyframeInterval = KEYFRAME_INTERVAL;
+	queuedCount = 0;
+	writtenCount = 0;
+	stopped = false;
+
+	// an existing log keeps its own interval, anything else is not overwritten
+	bool createLog = true;
+	FILE* existing = fopen(path.c_str(), "rb");
+	if (existing) {
+		GameLogHeader header;
+		size_t read = fread(&header, sizeof(header), 1, existing);
+		fseek(existing, 0, SEEK_END);
+		long size = ftell(existing);
+		fclose(existing);
+
+		if (read == 1 && header.magic == GAME_LOG_MAGIC && header.version == GAME_LOG_VERSION) {
+			keyframeInterval = header.keyframeInterval;
+			file = fopen(path.c_str(), "ab");
+			createLog = false;
+		}
+		else if (size != 0) {
+			return;
+		}
+	}
+	if (createLog) {
+		file = fopen(path.c_str(), "wb");
+		if (file) {
+			GameLogHeader header = GameLogHeader{ GAME_LOG_MAGIC, GAME_LOG_VERSION, keyframeInterval };
+			fwrite(&header, sizeof(header), 1, file);
+		}
+	}
+	if (file) {
+		writer = thread(&GameLogWriter::write, this);
+	}
+}
+
+GameLogWriter::~GameLogWriter()
+{
+	if (!file) {
+		return;
+	}
+	{
+		lock_guard<mutex> lock(eventsMutex);
+		stopped = true;
+		eventsQueued.notify_one();
+	}
+	writer.join();
+
+	// the games still going on are kept, without a result
+	for (auto& [game, openBlock] : openBlocks) {
+		writeBlock(openBlock);
+	}
+	fclose(file);
+}
+
+bool GameLogWriter::isOpen()
+{
+	return file;
+}
+
+void GameLogWriter::startGame(uint64_t game, BoardState position)
+{
+	LogEvent event = LogEvent{ StartEvent, game, 0, 0, rules.packPosition(position) };
+	queue(event);
+}
+
+void GameLogWriter::recordMove(uint64_t game, Move move)
+{
+	LogEvent event = LogEvent{ MoveEvent, game, encodeMove(move), 0, PackedPosition{} };
+	queue(event);
+}
+
+void GameLogWriter::endGame(uint64_t game, LogResult result)
+{
+	LogEvent event = LogEvent{ EndEvent, game, 0, uint8_t(result), PackedPosition{} };
+	queue(event);
+}
+
+void GameLogWriter::queue(const LogEvent& event)
+{
+	if (!file) {
+		return;
+	}
+	lock_guard<mutex> lock(eventsMutex);
+	events.push_back(event);
+	queuedCount++;
+	eventsQueued.notify_one();
+}
+
+void GameLogWriter::flush()
+{
+	if (!file) {
+		return;
+	}
+	unique_lock<mutex> lock(eventsMutex);
+	eventsWritten.wait(lock, [&]() { return writtenCount == queuedCount; });
+}
+
+// the writer thread, takes all the queued events at once so that the game threads
+// are only held for a push_back
+void GameLogWriter::write()
+{
+	vector<LogEvent> batch;
+	while (true) {
+		{
+			unique_lock<mutex> lock(eventsMutex);
+			eventsQueued.wait(lock, [&]() { return stopped || !events.empty(); });
+			if (events.empty()) {
+				return;
+			}
+			// the capacity of both vectors is kept from one batch to the next
+			swap(batch, events);
+		}
+
+		for (const LogEvent& event : batch) {
+			apply(event);
+		}
+		fflush(file);
+
+		lock_guard<mutex> lock(eventsMutex);
+		writtenCount += batch.size();
+		batch.clear();
+		eventsWritten.notify_all();
+	}
+}
+
+void GameLogWriter::apply(const LogEvent& event)
+{
+	if (event.type == StartEvent) {
+		OpenBlock& openBlock = openBlocks[event.game];
+		openBlock.block = GameLogBlock{ event.game, 0, 0, 0, ResultUnknown, event.position };
+		openBlock.moves.clear();
+		openBlock.position = rules.unpackPosition(event.position);
+		return;
+	}
+
+	auto found = openBlocks.find(event.game);
+	if (found == openBlocks.end()) {
+		// the start of the game was not logged
+		return;
+	}
+	OpenBlock& openBlock = found->second;
+
+	if (event.type == EndEvent) {
+		openBlock.block.flags |= LAST_BLOCK;
+		openBlock.block.result = event.result;
+		writeBlock(openBlock);
+		openBlocks.erase(found);
+		return;
+	}
+
+	openBlock.moves.push_back(event.move);
+	openBlock.position = rules.makeMove(decodeMove(event.move), openBlock.position);
+	if (openBlock.moves.size() == keyframeInterval) {
+		writeBlock(openBlock);
+		// the next block starts from where this one ends
+		openBlock.block.firstPly += keyframeInterval;
+		openBlock.block.keyframe = rules.packPosition(openBlock.position);
+		openBlock.moves.clear();
+	}
+}
+
+void GameLogWriter::writeBlock(OpenBlock& openBlock)
+{
+	openBlock.block.moveCount = uint16_t(openBlock.moves.size());
+	size_t movesSize = openBlock.moves.size() * sizeof(uint16_t);
+	size_t padding = getBlockSize(openBlock.block.moveCount) - sizeof(GameLogBlock) - movesSize;
+	static const uint8_t zeros[8] = {};
+
+	fwrite(&openBlock.block, sizeof(GameLogBlock), 1, file);
+	if (movesSize) {
+		fwrite(openBlock.moves.data(), movesSize, 1, file);
+	}
+	fwrite(zeros, padding, 1, file);
+}
+
+
+GameLogReader::GameLogReader()
+	: rules(kingsOnlyFEN) {
+	keyframeInterval = KEYFRAME_INTERVAL;
+}
+
+bool GameLogReader::open(string path)
+{
+	games.clear();
+	gameNumbers.clear();
+	if (!file.open(path) || file.getSize() < sizeof(GameLogHeader)) {
+		return false;
+	}
+
+	GameLogHeader header;
+	memcpy(&header, file.getData(), sizeof(header));
+	if (header.magic != GAME_LOG_MAGIC || header.version != GAME_LOG_VERSION || !header.keyframeInterval) {
+		return false;
+	}
+	keyframeInterval = header.keyframeInterval;
+
+	// the game each id currently refers to, an id used again starts a new game
+	map<uint64_t, size_t> currentGames;
+
+	// one pass over the block headers to find the blocks of each game
+	size_t offset = sizeof(GameLogHeader);
+	while (offset + sizeof(GameLogBlock) <= file.getSize()) {
+		const GameLogBlock* block = getBlock(offset);
+		size_t size = getBlockSize(block->moveCount);
+		if (offset + size > file.getSize()) {
+			// the writer was stopped in the middle of the block
+			break;
+		}
+
+		if (block->firstPly == 0) {
+			currentGames[block->game] = games.size();
+			gameNumbers.push_back(games.size());
+			games.push_back(LoggedGame{ block->game, {}, 0, ResultUnknown });
+		}
+		auto found = currentGames.find(block->game);
+		// the start of the game is missing, nothing before the block can be replayed
+		if (found == currentGames.end()) {
+			offset += size;
+			continue;
+		}
+		LoggedGame& game = games[found->second];
+		game.blocks.push_back(offset);
+		game.plyCount = block->firstPly + block->moveCount;
+		game.result = block->result;
+
+		offset += size;
+	}
+	return true;
+}
+
+const GameLogBlock* GameLogReader::getBlock(size_t offset)
+{
+	return (const GameLogBlock*)(file.getData() + offset);
+}
+
+const uint16_t* GameLogReader::getBlockMoves(size_t offset)
+{
+	return (const uint16_t*)(file.getData() + offset + sizeof(GameLogBlock));
+}
+
+bool GameLogReader::readKeyframe(const GameLogBlock* block, BoardState& position)
+{
+	try {
+		position = rules.unpackPosition(block->keyframe);
+	}
+	catch (const exception&) {
+		return false;
+	}
+	return true;
+}
+
+// only what makeMove needs not to corrupt the position, the logged moves are not checked for legality
+bool GameLogReader::playMove(uint16_t move, BoardState& position)
+{
+	Move decoded = decodeMove(move);
+	char piece = position.mailbox[decoded.from.x + decoded.from.y * 8];
+	char target = position.mailbox[decoded.to.x + decoded.to.y * 8];
+	if (!piece || bool(isupper(piece)) != position.WToMove
+		|| (target && bool(isupper(target)) == position.WToMove)) {
+		return false;
+	}
+	position = rules.makeMove(decoded, position);
+	return true;
+}
+
+const vector<uint64_t>& GameLogReader::getGames()
+{
+	return gameNumbers;
+}
+
+bool GameLogReader::hasGame(uint64_t game)
+{
+	return game < games.size();
+}
+
+uint64_t GameLogReader::getGameId(uint64_t game)
+{
+	return hasGame(game) ? games[game].id : 0;
+}
+
+uint32_t GameLogReader::getPlyCount(uint64_t game)
+{
+	return hasGame(game) ? games[game].plyCount : 0;
+}
+
+LogResult GameLogReader::getResult(uint64_t game)
+{
+	return hasGame(game) ? LogResult(games[game].result) : ResultUnknown;
+}
+
+vector<Move> GameLogReader::getMoves(uint64_t game)
+{
+	vector<Move> moves;
+	if (!hasGame(game)) {
+		return moves;
+	}
+	for (size_t offset : games[game].blocks) {
+		const uint16_t* blockMoves = getBlockMoves(offset);
+		for (uint16_t i = 0; i < getBlock(offset)->moveCount; i++) {
+			moves.push_back(decodeMove(blockMoves[i]));
+		}
+	}
+	return moves;
+}
+
+bool GameLogReader::seek(uint64_t game, uint32_t ply, BoardState& position)
+{
+	if (!hasGame(game) || ply > games[game].plyCount) {
+		return false;
+	}
+
+	// the blocks all hold keyframeInterval plies but the last one
+	const vector<size_t>& blocks = games[game].blocks;
+	size_t offset = blocks[min(size_t(ply / keyframeInterval), blocks.size() - 1)];
+	const GameLogBlock* block = getBlock(offset);
+	const uint16_t* moves = getBlockMoves(offset);
+
+	if (!readKeyframe(block, position)) {
+		return false;
+	}
+	for (uint32_t i = block->firstPly; i < ply; i++) {
+		if (!playMove(moves[i - block->firstPly], position)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#ifndef GAMELOG_H
+#define GAMELOG_H
+
+#include "Board.h"
+#include "MappedFile.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdio>
+
+/*
+Append-only binary log of games.
+
+The file starts with a GameLogHeader and is followed by blocks. A block holds up to
+keyframeInterval plies of one game : the packed position before its first ply (the
+keyframe) and then the moves, 16 bits each. The blocks of the games being played at
+the same time are interleaved, the blocks of one game are in ply order.
+Going to any ply of a game is replaying at most keyframeInterval - 1 moves from the
+keyframe of its block.
+*/
+
+#define GAME_LOG_MAGIC 0x474F4C5353454843ull // "CHESSLOG"
+#define GAME_LOG_VERSION 1
+#define KEYFRAME_INTERVAL 32
+
+typedef struct GameLogHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t keyframeInterval;
+} GameLogHeader;
+
+enum LogResult {
+	ResultUnknown,
+	ResultWhiteWins,
+	ResultBlackWins,
+	ResultDraw
+};
+
+// the block flags
+#define LAST_BLOCK 1
+
+typedef struct GameLogBlock {
+	uint64_t game;
+	uint32_t firstPly;
+	uint16_t moveCount;
+	uint8_t flags;
+	uint8_t result; // LogResult, only in the last block of a game
+	PackedPosition keyframe;
+	// followed by moveCount moves
+} GameLogBlock;
+
+// from square in the low 6 bits, to square in the next 6, the pawns always promote to a queen
+uint16_t encodeMove(Move move);
+Move decodeMove(uint16_t move);
+
+
+/*
+The game threads only queue what happened, a background thread groups the moves in
+blocks, replays them for the keyframes and writes to the file.
+*/
+class GameLogWriter {
+private:
+	enum EventType {
+		StartEvent,
+		MoveEvent,
+		EndEvent
+	};
+
+	typedef struct LogEvent {
+		EventType type;
+		uint64_t game;
+		uint16_t move;
+		uint8_t result;
+		PackedPosition position; // for StartEvent
+	} LogEvent;
+
+	// the block being filled for a game, the position is the one after its last move
+	typedef struct OpenBlock {
+		GameLogBlock block;
+		vector<uint16_t> moves;
+		BoardState position;
+	} OpenBlock;
+
+	FILE* file;
+	Board rules;
+	uint32_t keyframeInterval;
+
+	std::mutex eventsMutex;
+	std::condition_variable eventsQueued;
+	std::condition_variable eventsWritten;
+	vector<LogEvent> events;
+	unsigned long long queuedCount;
+	unsigned long long writtenCount;
+	bool stopped;
+	std::thread writer;
+
+	// only used by the writer thread
+	map<uint64_t, OpenBlock> openBlocks;
+
+	void queue(const LogEvent& event);
+	void write();
+	void apply(const LogEvent& event);
+	void writeBlock(OpenBlock& openBlock);
+
+public:
+	// appends to the file if it is already a game log
+	GameLogWriter(string path);
+	~GameLogWriter();
+
+	bool isOpen();
+	void startGame(uint64_t game, BoardState position);
+	void recordMove(uint64_t game, Move move);
+	void endGame(uint64_t game, LogResult result);
+	// blocks until everything queued is in the file
+	void flush();
+};
+
+
+/*
+The games are numbered in the order they started in the log. The ids given to the writer
+are not enough to tell them apart : a log can be appended to by several runs of the
+server, each one giving the same ids again, so every block starting at ply 0 is a new
+game and the next blocks with its id belong to it.
+*/
+class GameLogReader {
+private:
+	typedef struct LoggedGame {
+		uint64_t id; // given to the writer
+		// offsets in the file of the blocks of the game
+		vector<size_t> blocks;
+		uint32_t plyCount;
+		uint8_t result;
+	} LoggedGame;
+
+	MappedFile file;
+	Board rules;
+	uint32_t keyframeInterval;
+	vector<LoggedGame> games; // indexed by game number
+	vector<uint64_t> gameNumbers; // 0 to the number of games - 1
+
+	const GameLogBlock* getBlock(size_t offset);
+	const uint16_t* getBlockMoves(size_t offset);
+	// false if the keyframe of the block is corrupt
+	bool readKeyframe(const GameLogBlock* block, BoardState& position);
+	// false if the from square of the move does not hold a piece of the side to move
+	bool playMove(uint16_t move, BoardState& position);
+public:
+	GameLogReader();
+
+	// false if the file is not a game log, an incomplete last block is ignored
+	bool open(string path);
+
+	// the game numbers, the other functions take one of them
+	const vector<uint64_t>& getGames();
+	bool hasGame(uint64_t game);
+	// the id the game was given by the writer
+	uint64_t getGameId(uint64_t game);
+	uint32_t getPlyCount(uint64_t game);
+	LogResult getResult(uint64_t game);
+	vector<Move> getMoves(uint64_t game);
+	// the position before the move of ply, ply == getPlyCount is the final position.
+	// false if there is no such ply or the block holding it is corrupt
+	bool seek(uint64_t game, uint32_t ply, BoardState& position);
+
+	// calls visit(ply, position) for every position of the game, from the start.
+	// false if there is no such game or one of its blocks is corrupt, the positions of
+	// the corrupt block are not visited
+	template <typename Visitor>
+	bool replay(uint64_t game, Visitor visit) {
+		if (!hasGame(game)) {
+			return false;
+		}
+		const vector<size_t>& blocks = games[game].blocks;
+		for (size_t offset : blocks) {
+			const GameLogBlock* block = getBlock(offset);
+			const uint16_t* moves = getBlockMoves(offset);
+			BoardState position;
+			if (!readKeyframe(block, position)) {
+				return false;
+			}
+			for (uint32_t i = 0; i < block->moveCount; i++) {
+				visit(block->firstPly + i, position);
+				if (!playMove(moves[i], position)) {
+					return false;
+				}
+			}
+			if (offset == blocks.back()) {
+				visit(block->firstPly + block->moveCount, position);
+			}
+		}
+		return true;
+	}
+};
+
+#endif // !GAMELOG_H
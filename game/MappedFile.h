@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// read only view of a whole file through mmap (MapViewOfFile on Windows)
+class MappedFile {
+private:
+	const uint8_t* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// false if the file can't be read, an empty file is opened but has no data
+	bool open(const std::string& path);
+	void close();
+
+	const uint8_t* getData() const;
+	size_t getSize() const;
+};
+
+#endif // !MAPPEDFILE_H
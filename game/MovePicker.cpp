@@ -0,0 +1,206 @@
+#include "MovePicker.h"
+
+using namespace std;
+
+
+// piece order for MVV-LVA, the exact values don't matter
+static int pieceRank(char piece)
+{
+	switch (tolower(piece)) {
+	case 'p':
+		return 1;
+	case 'n':
+		return 2;
+	case 'b':
+		return 3;
+	case 'r':
+		return 4;
+	case 'q':
+		return 5;
+	case 'k':
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+
+MovePicker::MovePicker(Board& newRules, PickerBuffer& newBuffer, BoardState& newPosition, Move newHashMove,
+	Move killer1, Move killer2, Move counterMove, const int (*newHistory)[64])
+	: rules(newRules), position(newPosition), buffer(newBuffer) {
+	stage = HashMoveStage;
+	lastStage = HashMoveStage;
+	hashMove = newHashMove;
+	specialMoves[0] = killer1;
+	specialMoves[1] = killer2;
+	specialMoves[2] = counterMove;
+	specialIndex = 0;
+	generated = false;
+	buffer.badCaptures.clear();
+	badCaptureIndex = 0;
+	capturesOnly = false;
+	history = newHistory;
+}
+
+MovePicker::MovePicker(Board& newRules, PickerBuffer& newBuffer, BoardState& newPosition)
+	: rules(newRules), position(newPosition), buffer(newBuffer) {
+	stage = CapturesStage;
+	lastStage = CapturesStage;
+	hashMove = noMove;
+	specialMoves[0] = noMove;
+	specialMoves[1] = noMove;
+	specialMoves[2] = noMove;
+	specialIndex = 0;
+	generated = false;
+	buffer.badCaptures.clear();
+	badCaptureIndex = 0;
+	capturesOnly = true;
+	history = nullptr;
+}
+
+bool MovePicker::next(Move& move)
+{
+	while (stage != DoneStage) {
+		if (stage == HashMoveStage) {
+			stage = CapturesStage;
+			if (!(hashMove == noMove) && rules.isLegalMove(hashMove, position)) {
+				move = hashMove;
+				lastStage = HashMoveStage;
+				return true;
+			}
+		}
+		else if (stage == CapturesStage) {
+			if (!generated) {
+				rules.getLegalCaptures(position, buffer.moves);
+				for (int i = 0; i < buffer.moves.size(); i++) {
+					buffer.scores[i] = captureScore(buffer.moves[i]);
+				}
+				generated = true;
+			}
+			while (pickBest(move)) {
+				if (move == hashMove) {
+					continue;
+				}
+				if (!isGoodCapture(move)) {
+					// the quiescence search doesn't look at them at all
+					if (!capturesOnly) {
+						buffer.badCaptures.push(move);
+					}
+					continue;
+				}
+				lastStage = CapturesStage;
+				return true;
+			}
+			stage = capturesOnly ? DoneStage : KillersStage;
+			generated = false;
+		}
+		else if (stage == KillersStage) {
+			while (specialIndex < 3) {
+				Move special = specialMoves[specialIndex];
+				specialIndex++;
+
+				bool duplicate = special == hashMove;
+				for (int i = 0; i < specialIndex - 1; i++) {
+					duplicate = duplicate || special == specialMoves[i];
+				}
+				// the captures were already given
+				if (special == noMove || duplicate || rules.isCapture(special, position)
+					|| !rules.isLegalMove(special, position)) {
+					continue;
+				}
+
+				move = special;
+				lastStage = KillersStage;
+				return true;
+			}
+			stage = BadCapturesStage;
+		}
+		else if (stage == BadCapturesStage) {
+			if (badCaptureIndex < buffer.badCaptures.size()) {
+				move = buffer.badCaptures[badCaptureIndex];
+				badCaptureIndex++;
+				lastStage = BadCapturesStage;
+				return true;
+			}
+			stage = QuietsStage;
+		}
+		else if (stage == QuietsStage) {
+			if (!generated) {
+				rules.getLegalQuietMoves(position, buffer.moves);
+				for (int i = 0; i < buffer.moves.size(); i++) {
+					Move quiet = buffer.moves[i];
+					buffer.scores[i] = history[quiet.from.x + quiet.from.y * 8][quiet.to.x + quiet.to.y * 8];
+				}
+				generated = true;
+			}
+			while (pickBest(move)) {
+				if (!(move == hashMove) && !isSpecialMove(move)) {
+					lastStage = QuietsStage;
+					return true;
+				}
+			}
+			stage = DoneStage;
+		}
+	}
+	return false;
+}
+
+PickerStage MovePicker::getStage()
+{
+	return lastStage;
+}
+
+// selection sort one move at a time : most nodes cut off after a few moves,
+// sorting the whole list would be wasted
+bool MovePicker::pickBest(Move& move)
+{
+	MoveList& moves = buffer.moves;
+	if (moves.empty()) {
+		return false;
+	}
+
+	int best = 0;
+	for (int i = 1; i < moves.size(); i++) {
+		if (buffer.scores[i] > buffer.scores[best]) {
+			best = i;
+		}
+	}
+
+	int last = moves.size() - 1;
+	move = moves[best];
+	moves[best] = moves[last];
+	buffer.scores[best] = buffer.scores[last];
+	moves.count = last;
+	return true;
+}
+
+bool MovePicker::isSpecialMove(Move move)
+{
+	for (const Move& special : specialMoves) {
+		if (move == special) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int MovePicker::captureScore(Move move)
+{
+	char attacker = position.mailbox[move.from.x + move.from.y * 8];
+	char victim = position.mailbox[move.to.x + move.to.y * 8];
+	// en passant, the captured pawn is not on the target square
+	if (!victim && tolower(attacker) == 'p') {
+		victim = 'p';
+	}
+	return pieceRank(victim) * 8 - pieceRank(attacker);
+}
+
+bool MovePicker::isGoodCapture(Move move)
+{
+	char attacker = position.mailbox[move.from.x + move.from.y * 8];
+	char victim = position.mailbox[move.to.x + move.to.y * 8];
+	if (victim && pieceRank(attacker) <= pieceRank(victim)) {
+		return true;
+	}
+	return rules.see(move, position) >= 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+
+#include "Board.h"
+
+// the order in which the moves come out of the picker
+enum PickerStage {
+	HashMoveStage,
+	CapturesStage, // the captures that don't lose material
+	KillersStage, // killer moves and the counter move
+	BadCapturesStage, // the captures losing material according to the SEE
+	QuietsStage,
+	DoneStage
+};
+
+#define PICKER_STAGES 5
+
+// no move, used for the empty killer and counter move slots
+const Move noMove = Move{ {-1, -1}, {-1, -1} };
+
+// the lists of one picker, the search keeps one per ply so that picking allocates nothing
+typedef struct PickerBuffer {
+	// the moves of the current stage and their scores
+	MoveList moves;
+	int scores[MAX_MOVES];
+	// put aside during the captures stage, in MVV-LVA order
+	MoveList badCaptures;
+} PickerBuffer;
+
+
+/*
+Gives the legal moves of a position one at a time, best guesses first, for the search
+to cut off as early as possible. Each stage is only generated once the previous one
+is used up, so a cutoff on the hash move costs no move generation at all.
+The moves given by the search (hash, killers, counter) are checked for legality and
+never given twice.
+The quiescence search only gets the captures that don't lose material.
+*/
+class MovePicker {
+private:
+	Board& rules;
+	// the position of the caller : its attack information is computed once and kept there
+	BoardState& position;
+	PickerStage stage;
+	PickerStage lastStage;
+
+	Move hashMove;
+	// the two killers then the counter move
+	Move specialMoves[3];
+	int specialIndex;
+
+	// the moves of the current stage are picked by decreasing score
+	PickerBuffer& buffer;
+	bool generated;
+	int badCaptureIndex;
+	bool capturesOnly;
+	// history score of the side to move, indexed by from and to squares
+	const int (*history)[64];
+
+	bool pickBest(Move& move);
+	bool isSpecialMove(Move move);
+	// most valuable victim, least valuable attacker
+	int captureScore(Move move);
+	// the SEE is only needed when the attacker is worth more than the victim
+	bool isGoodCapture(Move move);
+
+public:
+	// the buffer is only used by this picker until it is done
+	MovePicker(Board& newRules, PickerBuffer& newBuffer, BoardState& newPosition, Move newHashMove,
+		Move killer1, Move killer2, Move counterMove, const int (*newHistory)[64]);
+	// for the quiescence search
+	MovePicker(Board& newRules, PickerBuffer& newBuffer, BoardState& newPosition);
+
+	// false once every legal move was given
+	bool next(Move& move);
+	// the stage the last move given came from
+	PickerStage getStage();
+};
+
+#endif // !MOVEPICKER_H
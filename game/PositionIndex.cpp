@@ -0,0 +1,313 @@
+#include "PositionIndex.h"
+#include "GameLog.h"
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+
+static void writeVarint(vector<uint8_t>& buffer, uint64_t value)
+{
+	while (value >= 0x80) {
+		buffer.push_back(uint8_t(value) | 0x80);
+		value >>= 7;
+	}
+	buffer.push_back(uint8_t(value));
+}
+
+static uint64_t readVarint(const uint8_t*& data)
+{
+	uint64_t value = 0;
+	int shift = 0;
+	while (*data & 0x80) {
+		value |= uint64_t(*data & 0x7F) << shift;
+		shift += 7;
+		data++;
+	}
+	value |= uint64_t(*data) << shift;
+	data++;
+	return value;
+}
+
+
+PositionIndexBuilder::PositionIndexBuilder(string newLogPath, string newIndexPath, int newThreads, size_t newRunSize) {
+	logPath = newLogPath;
+	indexPath = newIndexPath;
+	threads = max(1, newThreads);
+	runSize = max(size_t(1), newRunSize);
+	gameCount = 0;
+	positions = 0;
+	runCount = 0;
+	failed = false;
+}
+
+bool PositionIndexBuilder::build(IndexBuildStats& stats)
+{
+	stats = IndexBuildStats{};
+	{
+		GameLogReader log;
+		if (!log.open(logPath)) {
+			return false;
+		}
+		gameCount = log.getGames().size();
+	}
+
+	vector<thread> replayers;
+	for (int i = 0; i < threads; i++) {
+		replayers.push_back(thread(&PositionIndexBuilder::replayGames, this, i));
+	}
+	for (thread& replayer : replayers) {
+		replayer.join();
+	}
+
+	stats.games = gameCount;
+	stats.positions = positions;
+	stats.runs = runCount;
+	bool merged = !failed && merge(stats);
+
+	for (int run = 0; run < runCount; run++) {
+		remove(getRunPath(run).c_str());
+	}
+	return merged;
+}
+
+string PositionIndexBuilder::getRunPath(int run)
+{
+	return indexPath + ".run" + to_string(run);
+}
+
+void PositionIndexBuilder::replayGames(int threadIndex)
+{
+	// every thread maps the log on its own, the replays share nothing
+	GameLogReader log;
+	if (!log.open(logPath)) {
+		failed = true;
+		return;
+	}
+
+	vector<IndexEntry> entries;
+	entries.reserve(runSize);
+	for (uint64_t game = threadIndex; game < gameCount && !failed; game += threads) {
+		bool replayed = log.replay(game, [&](uint32_t ply, const BoardState& position) {
+			entries.push_back(IndexEntry{ position.hash, uint32_t(game), ply });
+			if (entries.size() == runSize) {
+				writeRun(entries);
+			}
+		});
+		if (!replayed) {
+			failed = true;
+		}
+	}
+	if (!entries.empty()) {
+		writeRun(entries);
+	}
+}
+
+void PositionIndexBuilder::writeRun(vector<IndexEntry>& entries)
+{
+	sort(entries.begin(), entries.end(), [](const IndexEntry& a, const IndexEntry& b) {
+		if (a.hash != b.hash) {
+			return a.hash < b.hash;
+		}
+		return a.game != b.game ? a.game < b.game : a.ply < b.ply;
+	});
+
+	int run = runCount++;
+	FILE* file = fopen(getRunPath(run).c_str(), "wb");
+	if (!file) {
+		failed = true;
+	}
+	else {
+		bool written = fwrite(entries.data(), sizeof(IndexEntry), entries.size(), file) == entries.size();
+		// fclose fails when the buffered end of the run could not be written
+		if (fclose(file) || !written) {
+			failed = true;
+		}
+	}
+	positions += entries.size();
+	entries.clear();
+}
+
+// k-way merge of the runs, the postings go straight to the index and the keys to a
+// temporary file that is appended at the end
+bool PositionIndexBuilder::merge(IndexBuildStats& stats)
+{
+	vector<unique_ptr<MappedFile>> runs;
+	for (int run = 0; run < runCount; run++) {
+		runs.push_back(make_unique<MappedFile>());
+		if (!runs.back()->open(getRunPath(run))) {
+			return false;
+		}
+	}
+
+	FILE* index = fopen(indexPath.c_str(), "wb");
+	string keysPath = indexPath + ".keys";
+	FILE* keysFile = fopen(keysPath.c_str(), "wb+");
+	if (!index || !keysFile) {
+		if (index) fclose(index);
+		if (keysFile) fclose(keysFile);
+		return false;
+	}
+
+	PositionIndexHeader header = PositionIndexHeader{};
+	header.magic = POSITION_INDEX_MAGIC;
+	header.version = POSITION_INDEX_VERSION;
+	header.gameCount = gameCount;
+	header.postingsOffset = sizeof(PositionIndexHeader);
+	// every write is checked at the end, a full disk leaves a truncated index otherwise
+	bool written = fwrite(&header, sizeof(header), 1, index) == 1;
+
+	// the smallest entry of each run on top
+	typedef pair<IndexEntry, size_t> HeapItem; // entry, run
+	auto greater = [](const HeapItem& a, const HeapItem& b) {
+		if (a.first.hash != b.first.hash) {
+			return a.first.hash > b.first.hash;
+		}
+		if (a.first.game != b.first.game) {
+			return a.first.game > b.first.game;
+		}
+		return a.first.ply > b.first.ply;
+	};
+	priority_queue<HeapItem, vector<HeapItem>, decltype(greater)> heap(greater);
+	vector<size_t> nextEntry(runs.size(), 0);
+	auto pushNext = [&](size_t run) {
+		size_t count = runs[run]->getSize() / sizeof(IndexEntry);
+		if (nextEntry[run] < count) {
+			IndexEntry entry;
+			memcpy(&entry, runs[run]->getData() + nextEntry[run] * sizeof(IndexEntry), sizeof(entry));
+			nextEntry[run]++;
+			heap.push(HeapItem{ entry, run });
+		}
+	};
+	for (size_t run = 0; run < runs.size(); run++) {
+		pushNext(run);
+	}
+
+	vector<uint8_t> buffer;
+	uint64_t postingsSize = 0;
+	bool firstKey = true;
+	U64 currentHash = 0;
+	uint32_t previousGame = 0;
+	uint32_t previousPly = 0;
+
+	while (!heap.empty()) {
+		IndexEntry entry = heap.top().first;
+		size_t run = heap.top().second;
+		heap.pop();
+		pushNext(run);
+
+		if (firstKey || entry.hash != currentHash) {
+			IndexKey key = IndexKey{ entry.hash, postingsSize + buffer.size() };
+			written &= fwrite(&key, sizeof(key), 1, keysFile) == 1;
+			stats.keys++;
+			firstKey = false;
+			currentHash = entry.hash;
+			writeVarint(buffer, entry.game);
+			writeVarint(buffer, entry.ply);
+		}
+		else {
+			writeVarint(buffer, entry.game - previousGame);
+			writeVarint(buffer, entry.game == previousGame ? entry.ply - previousPly : entry.ply);
+		}
+		previousGame = entry.game;
+		previousPly = entry.ply;
+
+		if (buffer.size() >= (1 << 20)) {
+			written &= fwrite(buffer.data(), 1, buffer.size(), index) == buffer.size();
+			postingsSize += buffer.size();
+			buffer.clear();
+		}
+	}
+	written &= fwrite(buffer.data(), 1, buffer.size(), index) == buffer.size();
+	postingsSize += buffer.size();
+
+	header.keyCount = stats.keys;
+	header.postingsSize = postingsSize;
+	header.keysOffset = header.postingsOffset + postingsSize;
+	// the keys are aligned for reading them in place
+	while (header.keysOffset % 8) {
+		written &= fputc(0, index) != EOF;
+		header.keysOffset++;
+	}
+
+	// append the keys
+	written &= fflush(keysFile) == 0 && fseek(keysFile, 0, SEEK_SET) == 0;
+	vector<uint8_t> copyBuffer(1 << 20);
+	size_t read;
+	while ((read = fread(copyBuffer.data(), 1, copyBuffer.size(), keysFile)) > 0) {
+		written &= fwrite(copyBuffer.data(), 1, read, index) == read;
+	}
+	written &= !ferror(keysFile);
+	fclose(keysFile);
+	remove(keysPath.c_str());
+
+	written &= fseek(index, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, index) == 1;
+	stats.bytes = header.keysOffset + header.keyCount * sizeof(IndexKey);
+	// fclose writes what is still buffered
+	written &= fclose(index) == 0;
+	if (!written) {
+		remove(indexPath.c_str());
+	}
+	return written;
+}
+
+
+bool PositionIndex::open(string path)
+{
+	if (!file.open(path) || file.getSize() < sizeof(PositionIndexHeader)) {
+		return false;
+	}
+	memcpy(&header, file.getData(), sizeof(header));
+	if (header.magic != POSITION_INDEX_MAGIC || header.version != POSITION_INDEX_VERSION
+		|| header.keysOffset + header.keyCount * sizeof(IndexKey) > file.getSize()) {
+		return false;
+	}
+	postings = file.getData() + header.postingsOffset;
+	keys = (const IndexKey*)(file.getData() + header.keysOffset);
+	return true;
+}
+
+vector<IndexHit> PositionIndex::find(U64 hash)
+{
+	vector<IndexHit> hits;
+	const IndexKey* end = keys + header.keyCount;
+	const IndexKey* key = lower_bound(keys, end, hash, [](const IndexKey& key, U64 hash) {
+		return key.hash < hash;
+	});
+	if (key == end || key->hash != hash) {
+		return hits;
+	}
+
+	const uint8_t* data = postings + key->postings;
+	const uint8_t* postingsEnd = postings + (key + 1 < end ? (key + 1)->postings : header.postingsSize);
+	uint64_t game = 0;
+	uint32_t ply = 0;
+	bool first = true;
+	while (data < postingsEnd) {
+		uint64_t gameDelta = readVarint(data);
+		uint32_t plyValue = uint32_t(readVarint(data));
+		ply = (first || gameDelta) ? plyValue : ply + plyValue;
+		game += gameDelta;
+		first = false;
+		hits.push_back(IndexHit{ game, ply });
+	}
+	return hits;
+}
+
+uint64_t PositionIndex::getKeyCount()
+{
+	return header.keyCount;
+}
+
+uint64_t PositionIndex::getGameCount()
+{
+	return header.gameCount;
+}
+
+U64 PositionIndex::getKeyHash(uint64_t key)
+{
+	return keys[key].hash;
+}
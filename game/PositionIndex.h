@@ -0,0 +1,113 @@
+#pragma once
+
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+
+#include "Board.h"
+#include "MappedFile.h"
+#include <atomic>
+
+/*
+On-disk index from the Zobrist hash of a position to the plies of the games that
+reached it.
+
+  PositionIndexHeader
+  postings              per hash, the (game, ply) pairs sorted, as varints : the game is
+                        its number in the log (see GameLogReader) and is
+                        stored as the difference with the previous one and the ply too
+                        when the game is the same
+  keys                  IndexKey sorted by hash, the postings of a hash end where the
+                        ones of the next hash start
+
+Built from a game log (see GameLog.h) with an external sort : every thread replays its
+share of the games and writes sorted runs, the runs are then merged into the index.
+*/
+
+#define POSITION_INDEX_MAGIC 0x5845444E49534F50ull // "POSINDEX"
+// 2 : the games are the numbers of the reader, not the ids of the writer
+// 3 : no table of the games, the postings hold their numbers
+#define POSITION_INDEX_VERSION 3
+
+typedef struct PositionIndexHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t unused;
+	uint64_t gameCount;
+	uint64_t keyCount;
+	uint64_t postingsOffset;
+	uint64_t postingsSize;
+	uint64_t keysOffset;
+} PositionIndexHeader;
+
+typedef struct IndexKey {
+	U64 hash;
+	uint64_t postings; // from postingsOffset
+} IndexKey;
+
+typedef struct IndexHit {
+	uint64_t game;
+	uint32_t ply;
+} IndexHit;
+
+typedef struct IndexBuildStats {
+	unsigned long long games;
+	unsigned long long positions;
+	unsigned long long keys;
+	unsigned long long runs;
+	unsigned long long bytes;
+} IndexBuildStats;
+
+
+class PositionIndexBuilder {
+private:
+	// one position of one game, what the runs are made of
+	typedef struct IndexEntry {
+		U64 hash;
+		uint32_t game;
+		uint32_t ply;
+	} IndexEntry;
+
+	string logPath;
+	string indexPath;
+	int threads;
+	size_t runSize;
+
+	uint64_t gameCount;
+	std::atomic<unsigned long long> positions;
+	std::atomic<int> runCount;
+	std::atomic<bool> failed; // a corrupt game in the log or a run that could not be written
+
+	string getRunPath(int run);
+	void replayGames(int threadIndex);
+	void writeRun(vector<IndexEntry>& entries);
+	bool merge(IndexBuildStats& stats);
+
+public:
+	// runSize is the number of positions a thread sorts in memory before writing a run
+	PositionIndexBuilder(string newLogPath, string newIndexPath, int newThreads, size_t newRunSize);
+
+	// false if the log could not be read, one of its games is corrupt or the index could
+	// not be written
+	bool build(IndexBuildStats& stats);
+};
+
+
+class PositionIndex {
+private:
+	MappedFile file;
+	PositionIndexHeader header;
+	const IndexKey* keys;
+	const uint8_t* postings;
+
+public:
+	// false if the file is not a position index
+	bool open(string path);
+
+	// the games and plies where the position was reached, in the order of the log
+	vector<IndexHit> find(U64 hash);
+	uint64_t getKeyCount();
+	uint64_t getGameCount();
+	U64 getKeyHash(uint64_t key);
+};
+
+#endif // !POSITIONINDEX_H
@@ -0,0 +1,140 @@
+#include "Board.h"
+#include "GameLog.h"
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Reads a game log (see GameLog.h).
+
+  gamelog file                      lists the games : number, id, plies and result
+  gamelog file --game n             the moves of the game
+  gamelog file --game n --ply n     the position before the move of ply n, as a FEN
+  gamelog file --bench              times going to random plies of random games
+
+The games are given by their number in the log, the ids of the server start again
+every time it appends to the log.
+
+usage : gamelog file [--game n] [--ply n] [--bench]
+*/
+
+
+static string resultName(LogResult result)
+{
+	switch (result) {
+	case ResultWhiteWins:
+		return "1-0";
+	case ResultBlackWins:
+		return "0-1";
+	case ResultDraw:
+		return "1/2-1/2";
+	default:
+		return "*";
+	}
+}
+
+static void benchSeek(GameLogReader& log)
+{
+	const vector<uint64_t>& games = log.getGames();
+	if (games.empty()) {
+		cout << "no games" << endl;
+		return;
+	}
+
+	mt19937 random(0);
+	const int seeks = 10000;
+	volatile U64 sink = 0;
+
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < seeks; i++) {
+		uint64_t game = games[random() % games.size()];
+		uint32_t ply = random() % (log.getPlyCount(game) + 1);
+		BoardState position;
+		log.seek(game, ply, position);
+		sink = sink ^ position.hash;
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << seeks << " seeks in " << games.size() << " games : "
+		<< fixed << setprecision(2) << seconds * 1e6 / seeks << " us per seek" << endl;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		cout << "usage : gamelog file [--game n] [--ply n] [--bench]" << endl;
+		return 1;
+	}
+
+	string path = argv[1];
+	bool hasGame = false;
+	uint64_t game = 0;
+	long long ply = -1;
+	bool bench = false;
+
+	for (int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--game" && hasValue) {
+			game = strtoull(argv[++i], nullptr, 10);
+			hasGame = true;
+		}
+		else if (arg == "--ply" && hasValue) ply = atoll(argv[++i]);
+		else if (arg == "--bench") bench = true;
+		else {
+			cout << "usage : gamelog file [--game n] [--ply n] [--bench]" << endl;
+			return 1;
+		}
+	}
+
+	GameLogReader log;
+	if (!log.open(path)) {
+		cout << path << " is not a game log" << endl;
+		return 1;
+	}
+
+	if (bench) {
+		benchSeek(log);
+		return 0;
+	}
+
+	if (!hasGame) {
+		for (uint64_t loggedGame : log.getGames()) {
+			cout << loggedGame << " " << log.getGameId(loggedGame) << " " << log.getPlyCount(loggedGame) << " "
+				<< resultName(log.getResult(loggedGame)) << endl;
+		}
+		return 0;
+	}
+
+	if (!log.hasGame(game)) {
+		cout << "no game " << game << " in " << path << endl;
+		return 1;
+	}
+
+	if (ply >= 0) {
+		BoardState position;
+		if (ply > log.getPlyCount(game)) {
+			cout << "the game only has " << log.getPlyCount(game) << " plies" << endl;
+			return 1;
+		}
+		if (!log.seek(game, uint32_t(ply), position)) {
+			cout << "game " << game << " is corrupt in " << path << endl;
+			return 1;
+		}
+		Board rules = Board("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+		cout << rules.getFEN(position) << endl;
+		return 0;
+	}
+
+	for (const Move& move : log.getMoves(game)) {
+		cout << moveToString(move) << " ";
+	}
+	cout << resultName(log.getResult(game)) << endl;
+	return 0;
+}
@@ -0,0 +1,327 @@
+#include "Board.h"
+#include "Engine.h"
+#include "MatchStats.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Plays games between two engine configs on every core to check that an engine change
+is an improvement. Each opening is played twice with the colours swapped.
+Results are reported from the point of view of engine1 and the match stops as soon as
+the SPRT is conclusive.
+
+usage : match [--engine1 key=value,...] [--engine2 key=value,...] [--games N]
+              [--threads N] [--openings file] [--maxplies N]
+              [--elo0 x] [--elo1 x] [--alpha x] [--beta x]
+
+engine keys : depth, nodes, time (ms), pawn, knight, bishop, rook, queen
+*/
+
+
+// used when no opening file is given
+static const vector<string> defaultOpenings = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+	"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+	"rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+	"rnbqkb1r/pppppppp/5n2/8/2P5/8/PP1PPPPP/RNBQKBNR w KQkq - 1 2",
+	"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+	"rnbqkbnr/pppp1ppp/4p3/8/3PP3/8/PPP2PPP/RNBQKBNR b KQkq - 0 2",
+	"rnbqkb1r/pppppp1p/5np1/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+};
+
+
+enum GameResult {
+	WhiteWins,
+	BlackWins,
+	Draw
+};
+
+typedef struct MatchSettings {
+	EngineConfig engine1;
+	EngineConfig engine2;
+	int maxGames;
+	int threads;
+	vector<BoardState> openings; // parsed before the games start
+	int maxPlies;
+
+	// a side is adjudicated lost once both engines agree it is down this much for resignPlies plies
+	int resignScore;
+	int resignPlies;
+
+	double elo0;
+	double elo1;
+	double alpha;
+	double beta;
+} MatchSettings;
+
+
+static bool onlyKingsLeft(BoardState position)
+{
+	for (auto& [piece, bitBoard] : position.piecesBitmaps) {
+		if (bitBoard && piece != 'K' && piece != 'k') {
+			return false;
+		}
+	}
+	return true;
+}
+
+static GameResult playGame(Board& rules, Engine& white, Engine& black, BoardState position, MatchSettings& settings)
+{
+	int resignStreak = 0; // > 0 when white is winning, < 0 when black is
+	PositionHistory history = PositionHistory{};
+	pushHistory(history, position.hash);
+
+	for (int ply = 0; ply < settings.maxPlies; ply++) {
+		GameStatus status = rules.getGameStatus(position, history);
+		if (status == Checkmate) {
+			return position.WToMove ? BlackWins : WhiteWins;
+		}
+		if (status != Ongoing || onlyKingsLeft(position)) {
+			return Draw;
+		}
+
+		Engine& mover = position.WToMove ? white : black;
+		SearchResult result = mover.search(position, history);
+
+		int whiteScore = position.WToMove ? result.score : -result.score;
+		if (whiteScore >= settings.resignScore) {
+			resignStreak = max(resignStreak, 0) + 1;
+		}
+		else if (whiteScore <= -settings.resignScore) {
+			resignStreak = min(resignStreak, 0) - 1;
+		}
+		else {
+			resignStreak = 0;
+		}
+		if (resignStreak >= settings.resignPlies) {
+			return WhiteWins;
+		}
+		if (resignStreak <= -settings.resignPlies) {
+			return BlackWins;
+		}
+
+		position = rules.makeMove(result.bestMove, position);
+		pushHistory(history, position.hash);
+	}
+
+	return Draw;
+}
+
+
+class MatchRunner {
+private:
+	MatchSettings settings;
+
+	atomic<int> nextGame;
+	atomic<bool> stopped;
+
+	mutex statsMutex;
+	MatchStats stats;
+
+	void worker() {
+		Board rules = Board(defaultOpenings[0]);
+		Engine engine1 = Engine(settings.engine1);
+		Engine engine2 = Engine(settings.engine2);
+
+		while (!stopped) {
+			int game = nextGame++;
+			if (settings.maxGames && game >= settings.maxGames) {
+				break;
+			}
+
+			// both colours are played from each opening
+			BoardState opening = settings.openings[(game / 2) % settings.openings.size()];
+			bool engine1White = game % 2 == 0;
+
+			GameResult result;
+			if (engine1White) {
+				result = playGame(rules, engine1, engine2, opening, settings);
+			}
+			else {
+				result = playGame(rules, engine2, engine1, opening, settings);
+			}
+
+			report(game, result, engine1White);
+		}
+	}
+
+	void report(int game, GameResult result, bool engine1White) {
+		lock_guard<mutex> lock(statsMutex);
+		if (stopped) {
+			// the test already concluded, don't count the games that were still running
+			return;
+		}
+
+		if (result == Draw) {
+			stats.draws++;
+		}
+		else if ((result == WhiteWins) == engine1White) {
+			stats.wins++;
+		}
+		else {
+			stats.losses++;
+		}
+
+		double ratio = llr(stats, settings.elo0, settings.elo1);
+		double lower = sprtLowerBound(settings.alpha, settings.beta);
+		double upper = sprtUpperBound(settings.alpha, settings.beta);
+
+		cout << "game " << setw(5) << game + 1
+			<< " | +" << stats.wins << " -" << stats.losses << " =" << stats.draws
+			<< " | elo " << fixed << setprecision(1) << elo(stats) << " +- " << eloError95(stats)
+			<< " | LLR " << setprecision(2) << ratio << " [" << lower << ", " << upper << "]" << endl;
+
+		if (ratio >= upper) {
+			cout << "H1 accepted : engine1 is at least " << settings.elo1 << " elo stronger" << endl;
+			stopped = true;
+		}
+		else if (ratio <= lower) {
+			cout << "H0 accepted : engine1 is not " << settings.elo1 << " elo stronger" << endl;
+			stopped = true;
+		}
+	}
+
+public:
+	MatchRunner(MatchSettings newSettings) {
+		settings = newSettings;
+		nextGame = 0;
+		stopped = false;
+		stats = MatchStats{ 0, 0, 0 };
+	}
+
+	MatchStats run() {
+		vector<thread> workers;
+		for (int i = 0; i < settings.threads; i++) {
+			workers.push_back(thread(&MatchRunner::worker, this));
+		}
+		for (thread& worker : workers) {
+			worker.join();
+		}
+		return stats;
+	}
+};
+
+
+// reads "key=value,key=value" into the config
+static bool parseEngineConfig(string text, EngineConfig& config)
+{
+	stringstream stream(text);
+	string option;
+	while (getline(stream, option, ',')) {
+		size_t equal = option.find('=');
+		if (equal == string::npos) {
+			return false;
+		}
+		string key = option.substr(0, equal);
+		long long value = atoll(option.substr(equal + 1).c_str());
+
+		if (key == "depth") config.maxDepth = int(value);
+		else if (key == "nodes") config.maxNodes = value;
+		else if (key == "time") config.maxTimeMs = int(value);
+		else if (key == "pawn") config.pawnValue = int(value);
+		else if (key == "knight") config.knightValue = int(value);
+		else if (key == "bishop") config.bishopValue = int(value);
+		else if (key == "rook") config.rookValue = int(value);
+		else if (key == "queen") config.queenValue = int(value);
+		else return false;
+	}
+	return true;
+}
+
+// every line is parsed here so that a bad FEN can't throw in the middle of the match.
+// false with the number of the line, from 1, if a FEN is invalid
+static bool readOpenings(string path, vector<BoardState>& openings, int& badLine)
+{
+	Board rules = Board(defaultOpenings[0]);
+	openings.clear();
+	ifstream file(path);
+	string line;
+	for (int lineNumber = 1; getline(file, line); lineNumber++) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		try {
+			openings.push_back(rules.ReadFEN(line));
+		}
+		catch (const exception&) {
+			badLine = lineNumber;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	MatchSettings settings = MatchSettings{};
+	settings.engine1 = defaultEngineConfig();
+	settings.engine1.maxNodes = 500;
+	settings.engine2 = settings.engine1;
+	settings.maxGames = 1000;
+	settings.threads = max(1, int(thread::hardware_concurrency()));
+	Board rules = Board(defaultOpenings[0]);
+	for (const string& fen : defaultOpenings) {
+		settings.openings.push_back(rules.ReadFEN(fen));
+	}
+	settings.maxPlies = 300;
+	settings.resignScore = 1000;
+	settings.resignPlies = 6;
+	settings.elo0 = 0.0;
+	settings.elo1 = 10.0;
+	settings.alpha = 0.05;
+	settings.beta = 0.05;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool valid = hasValue;
+
+		if (arg == "--engine1" && hasValue) valid = parseEngineConfig(argv[++i], settings.engine1);
+		else if (arg == "--engine2" && hasValue) valid = parseEngineConfig(argv[++i], settings.engine2);
+		else if (arg == "--games" && hasValue) settings.maxGames = atoi(argv[++i]);
+		else if (arg == "--threads" && hasValue) settings.threads = max(1, atoi(argv[++i]));
+		else if (arg == "--openings" && hasValue) {
+			string path = argv[++i];
+			int badLine = 0;
+			if (!readOpenings(path, settings.openings, badLine)) {
+				cout << "invalid fen on line " << badLine << " of " << path << endl;
+				valid = false;
+			}
+		}
+		else if (arg == "--maxplies" && hasValue) settings.maxPlies = atoi(argv[++i]);
+		else if (arg == "--elo0" && hasValue) settings.elo0 = atof(argv[++i]);
+		else if (arg == "--elo1" && hasValue) settings.elo1 = atof(argv[++i]);
+		else if (arg == "--alpha" && hasValue) settings.alpha = atof(argv[++i]);
+		else if (arg == "--beta" && hasValue) settings.beta = atof(argv[++i]);
+		else valid = false;
+
+		if (!valid || settings.openings.empty()) {
+			cout << "usage : match [--engine1 key=value,...] [--engine2 key=value,...] [--games N]\n"
+				<< "             [--threads N] [--openings file] [--maxplies N]\n"
+				<< "             [--elo0 x] [--elo1 x] [--alpha x] [--beta x]\n"
+				<< "engine keys : depth, nodes, time, pawn, knight, bishop, rook, queen" << endl;
+			return 1;
+		}
+	}
+
+	cout << "playing up to " << settings.maxGames << " games on " << settings.threads << " threads, "
+		<< settings.openings.size() << " openings" << endl;
+
+	MatchRunner runner = MatchRunner(settings);
+	MatchStats stats = runner.run();
+
+	cout << "final : +" << stats.wins << " -" << stats.losses << " =" << stats.draws
+		<< " elo " << fixed << setprecision(1) << elo(stats) << " +- " << eloError95(stats) << endl;
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "MatchStats.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+int gamesPlayed(MatchStats stats)
+{
+	return stats.wins + stats.losses + stats.draws;
+}
+
+double score(MatchStats stats)
+{
+	int games = gamesPlayed(stats);
+	if (games == 0) {
+		return 0.5;
+	}
+	return (stats.wins + 0.5 * stats.draws) / games;
+}
+
+double eloFromScore(double score)
+{
+	// a perfect score has an infinite elo difference, cap it
+	score = min(max(score, 0.001), 0.999);
+	return -400.0 * log10(1.0 / score - 1.0);
+}
+
+double elo(MatchStats stats)
+{
+	return eloFromScore(score(stats));
+}
+
+// variance of the score of one game
+static double scoreVariance(MatchStats stats)
+{
+	int games = gamesPlayed(stats);
+	if (games == 0) {
+		return 0.0;
+	}
+	double W = double(stats.wins) / games;
+	double D = double(stats.draws) / games;
+	double mean = W + D / 2;
+	return W + D / 4 - mean * mean;
+}
+
+double eloError95(MatchStats stats)
+{
+	int games = gamesPlayed(stats);
+	if (games == 0) {
+		return 0.0;
+	}
+	double error = 1.959964 * sqrt(scoreVariance(stats) / games);
+	return (eloFromScore(score(stats) + error) - eloFromScore(score(stats) - error)) / 2;
+}
+
+// normal approximation of the trinomial model, good enough once a few dozen games were played
+double llr(MatchStats stats, double elo0, double elo1)
+{
+	int games = gamesPlayed(stats);
+	double variance = scoreVariance(stats);
+	if (games == 0 || variance <= 0.0) {
+		return 0.0;
+	}
+
+	double s0 = 1.0 / (1.0 + pow(10.0, -elo0 / 400.0));
+	double s1 = 1.0 / (1.0 + pow(10.0, -elo1 / 400.0));
+	return (s1 - s0) * (2 * score(stats) - s0 - s1) / (2 * variance / games);
+}
+
+double sprtLowerBound(double alpha, double beta)
+{
+	return log(beta / (1 - alpha));
+}
+
+double sprtUpperBound(double alpha, double beta)
+{
+	return log((1 - beta) / alpha);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef MATCHSTATS_H
+#define MATCHSTATS_H
+
+/*
+Results of a match from the point of view of the first engine, with the usual
+logistic Elo model and a sequential probability ratio test (SPRT) on top.
+https://www.chessprogramming.org/Match_Statistics
+https://www.chessprogramming.org/Sequential_Probability_Ratio_Test
+*/
+typedef struct MatchStats {
+	int wins;
+	int losses;
+	int draws;
+} MatchStats;
+
+int gamesPlayed(MatchStats stats);
+double score(MatchStats stats);
+double eloFromScore(double score);
+double elo(MatchStats stats);
+// half width of the 95% confidence interval on elo
+double eloError95(MatchStats stats);
+
+// log likelihood ratio of H1 (elo = elo1) against H0 (elo = elo0)
+double llr(MatchStats stats, double elo0, double elo1);
+// the test stops once llr leaves [lowerBound, upperBound]
+double sprtLowerBound(double alpha, double beta);
+double sprtUpperBound(double alpha, double beta);
+
+#endif // !MATCHSTATS_H
@@ -0,0 +1,132 @@
+#include "Board.h"
+#include "PositionIndex.h"
+#include <thread>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Finds the games of a game log (see GameLog.h) that reached a position.
+
+  posindex build log index [--threads N] [--runsize N]   indexes every position of the log
+  posindex query index fen                               the games and plies that reached the position
+  posindex bench index                                   times the lookups of random positions
+
+usage : posindex build log index [--threads N] [--runsize N] | query index fen | bench index
+*/
+
+
+static void printUsage()
+{
+	cout << "usage : posindex build log index [--threads N] [--runsize N] | query index fen | bench index" << endl;
+}
+
+static int runBuild(int argc, char** argv)
+{
+	string logPath = argv[2];
+	string indexPath = argv[3];
+	int threads = max(1, int(thread::hardware_concurrency()));
+	size_t runSize = 1 << 22;
+
+	for (int i = 4; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--threads" && hasValue) threads = max(1, atoi(argv[++i]));
+		else if (arg == "--runsize" && hasValue) runSize = max(1ll, atoll(argv[++i]));
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	PositionIndexBuilder builder = PositionIndexBuilder(logPath, indexPath, threads, runSize);
+	IndexBuildStats stats;
+	auto start = chrono::steady_clock::now();
+	if (!builder.build(stats)) {
+		cout << "could not build " << indexPath << " from " << logPath << endl;
+		return 1;
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << stats.games << " games, " << stats.positions << " positions, " << stats.keys << " distinct, "
+		<< stats.runs << " runs, " << stats.bytes << " bytes" << endl;
+	cout << fixed << setprecision(2) << seconds << " s, "
+		<< setprecision(0) << double(stats.positions) / seconds << " positions/s" << endl;
+	return 0;
+}
+
+static int runQuery(PositionIndex& index, string fen)
+{
+	U64 hash;
+	try {
+		hash = Board(fen).getState().hash;
+	}
+	catch (const exception&) {
+		cout << "invalid fen" << endl;
+		return 1;
+	}
+
+	vector<IndexHit> hits = index.find(hash);
+	for (const IndexHit& hit : hits) {
+		cout << hit.game << " " << hit.ply << endl;
+	}
+	cout << hits.size() << " hits" << endl;
+	return 0;
+}
+
+static int runBench(PositionIndex& index)
+{
+	if (!index.getKeyCount()) {
+		cout << "empty index" << endl;
+		return 1;
+	}
+
+	// half of the lookups miss
+	mt19937_64 random(0);
+	const int lookups = 100000;
+	vector<U64> hashes;
+	for (int i = 0; i < lookups; i++) {
+		hashes.push_back(i % 2 ? random() : index.getKeyHash(random() % index.getKeyCount()));
+	}
+
+	unsigned long long hits = 0;
+	auto start = chrono::steady_clock::now();
+	for (U64 hash : hashes) {
+		hits += index.find(hash).size();
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << lookups << " lookups in " << index.getKeyCount() << " positions of " << index.getGameCount() << " games : "
+		<< fixed << setprecision(2) << seconds * 1e6 / lookups << " us per lookup, " << hits << " hits" << endl;
+	return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		printUsage();
+		return 1;
+	}
+
+	string command = argv[1];
+	if (command == "build" && argc >= 4) {
+		return runBuild(argc, argv);
+	}
+	if ((command == "query" && argc == 4) || (command == "bench" && argc == 3)) {
+		PositionIndex index;
+		if (!index.open(argv[2])) {
+			cout << argv[2] << " is not a position index" << endl;
+			return 1;
+		}
+		return command == "query" ? runQuery(index, argv[3]) : runBench(index);
+	}
+
+	printUsage();
+	return 1;
+}
@@ -0,0 +1,134 @@
+#include "BoardRenderer.h"
+
+using namespace std;
+
+
+// in the order of the RenderLayer flags, blended over the square colors
+static const Color layerColors[3] = {
+	Color{ 255, 255, 0, 100 }, // last move
+	Color{ 0, 0, 255, 100 }, // attacks, the same blue as the game
+	Color{ 255, 0, 0, 150 }, // check
+};
+
+// overlay drawn over an opaque color
+static Color blend(Color base, Color overlay)
+{
+	auto mix = [&](unsigned char under, unsigned char over) {
+		return (unsigned char)((over * overlay.a + under * (255 - overlay.a)) / 255);
+	};
+	return Color{ mix(base.r, overlay.r), mix(base.g, overlay.g), mix(base.b, overlay.b), 255 };
+}
+
+
+BoardRenderer::BoardRenderer(RenderSettings newSettings) {
+	settings = newSettings;
+	for (Image& image : pieceImages) {
+		image = Image{};
+	}
+	emptyBoard = Image{};
+	loaded = false;
+}
+
+BoardRenderer::~BoardRenderer()
+{
+	if (!loaded) {
+		return;
+	}
+	for (Image& image : pieceImages) {
+		UnloadImage(image);
+	}
+	UnloadImage(emptyBoard);
+}
+
+bool BoardRenderer::loadSprites(const string& path)
+{
+	if (loaded) {
+		return true;
+	}
+	Image sheet = LoadImage(path.c_str());
+	if (!sheet.width) {
+		return false;
+	}
+
+	// the same tiles as Board::LoadPiecesImages
+	ImageCrop(&sheet, Rectangle{ 2, 1, 2556, 852 });
+	// ImageDraw would convert any other format on every call
+	ImageFormat(&sheet, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	for (int i = 0; i < 12; i++) {
+		pieceImages[i] = ImageCopy(sheet);
+		ImageCrop(&pieceImages[i], Rectangle{ float(i % 6 * 426), float(i / 6 * 426), 426, 426 });
+		ImageResize(&pieceImages[i], settings.squareSize, settings.squareSize);
+	}
+	UnloadImage(sheet);
+
+	// a8 is a light square
+	emptyBoard = GenImageColor(settings.squareSize * 8, settings.squareSize * 8, settings.lightColor);
+	for (int square = 0; square < 64; square++) {
+		if ((square % 8 + square / 8) % 2) {
+			drawSquare(emptyBoard, square, settings.darkColor);
+		}
+	}
+
+	loaded = true;
+	return true;
+}
+
+void BoardRenderer::drawSquare(Image& image, int square, Color color) const
+{
+	ImageDrawRectangle(&image, square % 8 * settings.squareSize, square / 8 * settings.squareSize,
+		settings.squareSize, settings.squareSize, color);
+}
+
+// ImageDrawRectangle replaces the pixels without blending, so the highlights are blended here
+Color BoardRenderer::squareColor(int square, int layers) const
+{
+	Color color = (square % 8 + square / 8) % 2 ? settings.darkColor : settings.lightColor;
+	for (int layer = 0; layer < 3; layer++) {
+		if (layers & (1 << layer)) {
+			color = blend(color, layerColors[layer]);
+		}
+	}
+	return color;
+}
+
+Image BoardRenderer::render(Board& rules, const BoardState& position, Move lastMove) const
+{
+	Image image = ImageCopy(emptyBoard);
+
+	// the layers highlighting each square, same indices as the mailbox
+	int squareLayers[64] = {};
+	if ((settings.layers & LastMoveLayer) && lastMove.from.x >= 0) {
+		squareLayers[lastMove.from.x + lastMove.from.y * 8] |= LastMoveLayer;
+		squareLayers[lastMove.to.x + lastMove.to.y * 8] |= LastMoveLayer;
+	}
+	// the attack information is computed once in the copy, for both layers
+	BoardState working = position;
+	if (settings.layers & AttacksLayer) {
+		U64 attacked = rules.getAttackedSquares(working.WToMove ? White : Black, working);
+		while (attacked) {
+			squareLayers[lowestSquare(attacked)] |= AttacksLayer;
+			attacked &= attacked - 1;
+		}
+	}
+	if ((settings.layers & CheckLayer) && rules.isInCheck(working)) {
+		U64 king = position.piecesBitmaps[position.WToMove ? 'K' : 'k'];
+		if (king) {
+			squareLayers[lowestSquare(king)] |= CheckLayer;
+		}
+	}
+	for (int square = 0; square < 64; square++) {
+		if (squareLayers[square]) {
+			drawSquare(image, square, squareColor(square, squareLayers[square]));
+		}
+	}
+
+	float size = float(settings.squareSize);
+	for (int square = 0; square < 64; square++) {
+		char piece = position.mailbox[square];
+		if (piece) {
+			ImageDraw(&image, pieceImages[pieceIndex(piece)], Rectangle{ 0, 0, size, size },
+				Rectangle{ square % 8 * size, square / 8 * size, size, size }, WHITE);
+		}
+	}
+	return image;
+}
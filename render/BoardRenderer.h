@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef BOARDRENDERER_H
+#define BOARDRENDERER_H
+
+#include "Board.h"
+
+// highlight layers, combined as flags. They are drawn in this order, under the pieces
+enum RenderLayer {
+	LastMoveLayer = 1, // the from and to squares of the move that led to the position
+	AttacksLayer = 2, // the squares attacked by the side to move, as on the game board
+	CheckLayer = 4, // the king of the side to move when it is in check
+};
+
+typedef struct RenderSettings {
+	int squareSize;
+	Color lightColor;
+	Color darkColor;
+	int layers; // RenderLayer flags
+} RenderSettings;
+
+
+/*
+Draws board diagrams into raylib Images on the CPU, without any window or GPU : the
+textures of Board::drawBoard need InitWindow.
+
+The sprite sheet is cut and resized once and the empty board is drawn once, each
+diagram starts as a copy of it. Everything loaded is only read afterwards, so one
+renderer can be shared by any number of threads, each with its own Board.
+*/
+class BoardRenderer {
+private:
+	RenderSettings settings;
+	// in the order of pieceIndex
+	Image pieceImages[12];
+	Image emptyBoard;
+	bool loaded;
+
+	void drawSquare(Image& image, int square, Color color) const;
+	// the square color with the highlight colors blended over it, in layer order
+	Color squareColor(int square, int layers) const;
+
+public:
+	BoardRenderer(RenderSettings newSettings);
+	~BoardRenderer();
+	BoardRenderer(const BoardRenderer&) = delete;
+	BoardRenderer& operator=(const BoardRenderer&) = delete;
+
+	// the sprite sheet of the game (allPieces.png), false if it could not be loaded
+	bool loadSprites(const string& path);
+	// the diagram of the position, to be unloaded by the caller. lastMove is only used by
+	// the last move layer, a from square of -1 means there is none
+	Image render(Board& rules, const BoardState& position, Move lastMove) const;
+};
+
+#endif // !BOARDRENDERER_H
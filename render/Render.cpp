@@ -0,0 +1,195 @@
+#include "Board.h"
+#include "BoardRenderer.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Renders board diagrams to PNG files on every core, without a window : the thumbnails of
+many positions on a server with no display (see BoardRenderer.h).
+
+The input has one position per line, a FEN optionally followed by the last move in
+coordinate notation ("... w - - 0 1 e2e4"). The diagram of line n is written to
+<output>/<n>.png, the lines are counted from 0 and the empty ones are skipped.
+
+--layers takes a comma separated list of highlight layers : lastmove, attacks, check.
+
+usage : render positions [--output dir] [--size pixels] [--layers list] [--threads N]
+                         [--sprites path]
+*/
+
+
+static const string startingFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+typedef struct RenderJob {
+	int line;
+	string text;
+} RenderJob;
+
+
+// -1 for an unknown layer name
+static int parseLayers(const string& list)
+{
+	int layers = 0;
+	stringstream stream(list);
+	string name;
+	while (getline(stream, name, ',')) {
+		if (name == "lastmove") layers |= LastMoveLayer;
+		else if (name == "attacks") layers |= AttacksLayer;
+		else if (name == "check") layers |= CheckLayer;
+		else if (name != "none" && !name.empty()) return -1;
+	}
+	return layers;
+}
+
+// the six fields of the FEN, then the optional move. false for a line that is not a valid position
+static bool parseJob(Board& rules, const string& text, BoardState& position, Move& lastMove)
+{
+	stringstream stream(text);
+	vector<string> fields;
+	string field;
+	while (stream >> field) {
+		fields.push_back(field);
+	}
+	if (fields.size() < 6 || fields.size() > 7) {
+		return false;
+	}
+
+	string fen = fields[0];
+	for (int i = 1; i < 6; i++) {
+		fen += " " + fields[i];
+	}
+	lastMove = fields.size() == 7 ? moveFromString(fields[6]) : Move{ {-1, -1}, {-1, -1} };
+	if (fields.size() == 7 && lastMove.from.x < 0) {
+		return false;
+	}
+
+	try {
+		position = rules.ReadFEN(fen);
+	}
+	catch (const exception&) {
+		return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		cout << "usage : render positions [--output dir] [--size pixels] [--layers list] [--threads N]\n"
+			<< "                         [--sprites path]" << endl;
+		return 1;
+	}
+
+	string input = argv[1];
+	string output = ".";
+	string sprites = string(GetApplicationDirectory()) + "allPieces.png";
+	int threads = max(1, int(thread::hardware_concurrency()));
+	RenderSettings settings = RenderSettings{};
+	settings.squareSize = 32;
+	settings.lightColor = Color{ 238, 238, 210, 255 };
+	settings.darkColor = Color{ 118, 150, 86, 255 };
+	settings.layers = LastMoveLayer;
+
+	for (int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--output" && hasValue) output = argv[++i];
+		else if (arg == "--size" && hasValue) settings.squareSize = max(8, atoi(argv[++i]) / 8);
+		else if (arg == "--layers" && hasValue) settings.layers = parseLayers(argv[++i]);
+		else if (arg == "--threads" && hasValue) threads = max(1, atoi(argv[++i]));
+		else if (arg == "--sprites" && hasValue) sprites = argv[++i];
+		else {
+			cout << "usage : render positions [--output dir] [--size pixels] [--layers list] [--threads N]\n"
+				<< "                         [--sprites path]" << endl;
+			return 1;
+		}
+	}
+	if (settings.layers < 0) {
+		cout << "the layers are lastmove, attacks and check" << endl;
+		return 1;
+	}
+
+	// raylib logs every exported image otherwise
+	SetTraceLogLevel(LOG_WARNING);
+
+	ifstream file(input);
+	if (!file) {
+		cout << "could not open " << input << endl;
+		return 1;
+	}
+	vector<RenderJob> jobs;
+	string text;
+	for (int line = 0; getline(file, text); line++) {
+		if (!text.empty()) {
+			jobs.push_back(RenderJob{ line, text });
+		}
+	}
+
+	// cut once, then only read by the workers
+	BoardRenderer renderer = BoardRenderer(settings);
+	if (!renderer.loadSprites(sprites)) {
+		cout << "could not load the sprite sheet " << sprites << endl;
+		return 1;
+	}
+
+	cout << "rendering " << jobs.size() << " positions at " << settings.squareSize * 8 << " px on "
+		<< threads << " threads" << endl;
+
+	atomic<int> nextJob = 0;
+	atomic<int> invalid = 0;
+	atomic<int> failed = 0;
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(thread([&]() {
+			Board rules = Board(startingFEN);
+			while (true) {
+				int index = nextJob++;
+				if (index >= int(jobs.size())) {
+					break;
+				}
+
+				BoardState position;
+				Move lastMove;
+				if (!parseJob(rules, jobs[index].text, position, lastMove)) {
+					invalid++;
+					continue;
+				}
+				Image image = renderer.render(rules, position, lastMove);
+				string path = output + "/" + to_string(jobs[index].line) + ".png";
+				if (!ExportImage(image, path.c_str())) {
+					failed++;
+				}
+				UnloadImage(image);
+			}
+		}));
+	}
+	for (thread& worker : workers) {
+		worker.join();
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	int rendered = int(jobs.size()) - invalid - failed;
+	cout << rendered << " images in " << fixed << setprecision(2) << seconds << " s, "
+		<< setprecision(0) << rendered / seconds << " images/s" << endl;
+	if (invalid) {
+		cout << invalid << " invalid lines skipped" << endl;
+	}
+	if (failed) {
+		cout << failed << " images could not be written to " << output << endl;
+		return 1;
+	}
+	return 0;
+}
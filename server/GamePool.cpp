@@ -0,0 +1,81 @@
+#include "GamePool.h"
+
+using namespace std;
+
+
+uint32_t slotIndex(GameId game)
+{
+	return uint32_t(game & 0xFFFFFFFFull);
+}
+
+static GameId makeGameId(uint32_t index, uint32_t generation)
+{
+	return (GameId(generation) << 32) | index;
+}
+
+
+GamePool::GamePool(int capacity)
+	: slots(capacity), histories(capacity) {
+	// handed out from the lowest index
+	for (int index = capacity - 1; index >= 0; index--) {
+		freeSlots.push_back(uint32_t(index));
+	}
+	for (GameSlot& slot : slots) {
+		// generation 0 is never used so that no id is NO_GAME
+		slot.generation = 0;
+		slot.active = false;
+	}
+	activeGames = 0;
+}
+
+GameId GamePool::allocate()
+{
+	lock_guard<mutex> lock(freeSlotsMutex);
+	if (freeSlots.empty()) {
+		return NO_GAME;
+	}
+	uint32_t index = freeSlots.back();
+	freeSlots.pop_back();
+	activeGames++;
+
+	uint32_t generation = slots[index].generation + 1;
+	slots[index].generation = generation;
+	return makeGameId(index, generation);
+}
+
+void GamePool::release(GameId game)
+{
+	GameSlot* slot = find(game);
+	if (!slot) {
+		return;
+	}
+	slot->active = false;
+
+	lock_guard<mutex> lock(freeSlotsMutex);
+	freeSlots.push_back(slotIndex(game));
+	activeGames--;
+}
+
+GameSlot* GamePool::find(GameId game)
+{
+	uint32_t index = slotIndex(game);
+	if (index >= slots.size() || slots[index].generation != uint32_t(game >> 32)) {
+		return nullptr;
+	}
+	return &slots[index];
+}
+
+PositionHistory& GamePool::getHistory(GameId game)
+{
+	return histories[slotIndex(game)];
+}
+
+int GamePool::getCapacity()
+{
+	return int(slots.size());
+}
+
+int GamePool::getActiveGames()
+{
+	return activeGames;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef GAMEPOOL_H
+#define GAMEPOOL_H
+
+#include "Board.h"
+#include <atomic>
+#include <mutex>
+
+// the slot index is in the low 32 bits, the generation of the slot in the high ones
+// so that an old id doesn't reach the game that reused its slot
+typedef unsigned long long GameId;
+
+#define NO_GAME 0ull
+
+
+// what a request needs of a game, one cache line per game so that two workers
+// never write to the same line
+typedef struct alignas(64) GameSlot {
+	PackedPosition position;
+	std::atomic<uint32_t> generation;
+	uint8_t status; // GameStatus
+	bool active;
+} GameSlot;
+
+
+/*
+Preallocated storage for all the games of the server.
+The slots are only touched by the worker owning them, the pool itself only
+hands out and takes back slots. The position histories are kept apart from the
+slots : they are only needed after a move, for the repetitions.
+
+A game takes its 64 byte slot and a history of HISTORY_SIZE hashes (2 KB), about
+2.1 KB in all : the default capacity of 16384 games is 34 MB.
+*/
+class GamePool {
+private:
+	vector<GameSlot> slots;
+	vector<PositionHistory> histories;
+
+	std::mutex freeSlotsMutex;
+	vector<uint32_t> freeSlots;
+	std::atomic<int> activeGames;
+
+public:
+	GamePool(int capacity);
+
+	// NO_GAME when the pool is full
+	GameId allocate();
+	void release(GameId game);
+	// nullptr if the id is not the game currently in its slot
+	GameSlot* find(GameId game);
+	PositionHistory& getHistory(GameId game);
+
+	int getCapacity();
+	int getActiveGames();
+};
+
+uint32_t slotIndex(GameId game);
+
+#endif // !GAMEPOOL_H
@@ -0,0 +1,394 @@
+#include "GameServer.h"
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+static const string startingFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static LogResult resultOf(GameStatus status, const BoardState& position)
+{
+	if (status == Checkmate) {
+		return position.WToMove ? ResultBlackWins : ResultWhiteWins;
+	}
+	return status == Ongoing ? ResultUnknown : ResultDraw;
+}
+
+static string statusName(GameStatus status)
+{
+	switch (status) {
+	case Checkmate:
+		return "checkmate";
+	case Stalemate:
+		return "stalemate";
+	case ThreefoldRepetition:
+		return "repetition";
+	case FiftyMoveRule:
+		return "fiftymoves";
+	default:
+		return "ongoing";
+	}
+}
+
+
+Connection::Connection(ConnectionKind newKind, int newSocket) {
+	kind = newKind;
+	socket = newSocket;
+	requestCount = 0;
+	nextResponse = 0;
+}
+
+bool Connection::readLine(string& line)
+{
+	if (kind == StandardStreams) {
+		return bool(getline(cin, line));
+	}
+
+#ifndef _WIN32
+	if (kind == SocketConnection) {
+		size_t end;
+		while ((end = readBuffer.find('\n')) == string::npos) {
+			char buffer[4096];
+			ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+			if (received <= 0) {
+				// the last line doesn't need a line break
+				line = readBuffer;
+				readBuffer.clear();
+				return !line.empty();
+			}
+			readBuffer.append(buffer, received);
+		}
+		line = readBuffer.substr(0, end);
+		readBuffer.erase(0, end + 1);
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+unsigned long long Connection::nextSequence()
+{
+	lock_guard<mutex> lock(responsesMutex);
+	return requestCount++;
+}
+
+void Connection::complete(unsigned long long sequence, const string& response)
+{
+	lock_guard<mutex> lock(responsesMutex);
+	waitingResponses[sequence] = response;
+
+	// everything that is now in order goes out in one write
+	string text;
+	auto next = waitingResponses.find(nextResponse);
+	while (next != waitingResponses.end()) {
+		if (kind == CapturedConnection) {
+			capturedResponses.push_back(next->second);
+		}
+		else {
+			text += next->second + "\n";
+		}
+		waitingResponses.erase(next);
+		nextResponse++;
+		next = waitingResponses.find(nextResponse);
+	}
+	if (!text.empty()) {
+		write(text);
+	}
+	if (nextResponse == requestCount) {
+		responsesDone.notify_all();
+	}
+}
+
+void Connection::write(const string& text)
+{
+	if (kind == StandardStreams) {
+		cout << text << flush;
+	}
+#ifndef _WIN32
+	else if (kind == SocketConnection) {
+		size_t sent = 0;
+		while (sent < text.size()) {
+			ssize_t written = send(socket, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+			if (written <= 0) {
+				// the client is gone, nobody reads the rest
+				return;
+			}
+			sent += written;
+		}
+	}
+#endif
+}
+
+void Connection::waitForResponses()
+{
+	unique_lock<mutex> lock(responsesMutex);
+	responsesDone.wait(lock, [&]() { return nextResponse == requestCount; });
+}
+
+vector<string>& Connection::getCapturedResponses()
+{
+	return capturedResponses;
+}
+
+
+GameServer::Worker::Worker()
+	: rules(startingFEN) {
+	for (atomic<unsigned long long>& bucket : latencies) {
+		bucket = 0;
+	}
+	requests = 0;
+}
+
+GameServer::GameServer(int threads, int capacity, GameLogWriter* newLog)
+	: pool(capacity) {
+	log = newLog;
+	stopped = false;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(make_unique<Worker>());
+	}
+	for (unique_ptr<Worker>& worker : workers) {
+		worker->thread = thread(&GameServer::work, this, ref(*worker));
+	}
+}
+
+GameServer::~GameServer()
+{
+	stopped = true;
+	for (unique_ptr<Worker>& worker : workers) {
+		{
+			lock_guard<mutex> lock(worker->queueMutex);
+			worker->queueNotEmpty.notify_all();
+		}
+		worker->thread.join();
+	}
+}
+
+void GameServer::work(Worker& worker)
+{
+	while (true) {
+		Request request;
+		{
+			unique_lock<mutex> lock(worker.queueMutex);
+			worker.queueNotEmpty.wait(lock, [&]() { return stopped || !worker.queue.empty(); });
+			if (worker.queue.empty()) {
+				return;
+			}
+			request = move(worker.queue.front());
+			worker.queue.pop_front();
+		}
+
+		auto start = chrono::steady_clock::now();
+		string response = handle(worker, request);
+		auto end = chrono::steady_clock::now();
+
+		long long ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+		int bucket = int(min<long long>(ns / LATENCY_BUCKET_NS, LATENCY_BUCKETS));
+		worker.latencies[bucket].fetch_add(1, memory_order_relaxed);
+		worker.requests.fetch_add(1, memory_order_relaxed);
+
+		request.connection->complete(request.sequence, response);
+	}
+}
+
+void GameServer::dispatch(Request request)
+{
+	Worker& worker = *workers[slotIndex(request.game) % workers.size()];
+	lock_guard<mutex> lock(worker.queueMutex);
+	worker.queue.push_back(move(request));
+	worker.queueNotEmpty.notify_one();
+}
+
+// runs on the worker owning the game
+string GameServer::handle(Worker& worker, Request& request)
+{
+	GameSlot* slot = pool.find(request.game);
+	if (!slot) {
+		return "error unknown game";
+	}
+
+	if (request.command == NewGame) {
+		BoardState position;
+		PackedPosition packed;
+		try {
+			position = worker.rules.ReadFEN(request.argument.empty() ? startingFEN : request.argument);
+			// more than 32 pieces don't fit in the slot
+			packed = worker.rules.packPosition(position);
+		}
+		catch (const exception&) {
+			pool.release(request.game);
+			return "error invalid fen";
+		}
+		PositionHistory& history = pool.getHistory(request.game);
+		history.count = 0;
+		pushHistory(history, position.hash);
+		slot->position = packed;
+		slot->status = worker.rules.getGameStatus(position, history);
+		slot->active = true;
+		if (log) {
+			log->startGame(request.game, position);
+		}
+		return "ok " + to_string(request.game);
+	}
+
+	if (!slot->active) {
+		return "error unknown game";
+	}
+
+	if (request.command == EndGame) {
+		// the games that ended on the board were already logged with their result
+		if (log && slot->status == Ongoing) {
+			log->endGame(request.game, ResultUnknown);
+		}
+		pool.release(request.game);
+		return "ok";
+	}
+	if (request.command == GetStatus) {
+		return "ok " + statusName(GameStatus(slot->status));
+	}
+
+	BoardState position = worker.rules.unpackPosition(slot->position);
+
+	if (request.command == GetFEN) {
+		return "ok " + worker.rules.getFEN(position);
+	}
+	if (request.command == ListMoves) {
+		string response = "ok";
+		for (const Move& move : worker.rules.getLegalMoves(position)) {
+			response += " " + moveToString(move);
+		}
+		return response;
+	}
+
+	// PlayMove
+	if (slot->status != Ongoing) {
+		return "error game over";
+	}
+	Move move = moveFromString(request.argument);
+	if (move.from.x < 0) {
+		return "error invalid move";
+	}
+	if (!worker.rules.isLegalMove(move, position)) {
+		return "illegal";
+	}
+	position = worker.rules.makeMove(move, position);
+	PositionHistory& history = pool.getHistory(request.game);
+	pushHistory(history, position.hash);
+	slot->status = worker.rules.getGameStatus(position, history);
+	slot->position = worker.rules.packPosition(position);
+	if (log) {
+		log->recordMove(request.game, move);
+		if (slot->status != Ongoing) {
+			log->endGame(request.game, resultOf(GameStatus(slot->status), position));
+		}
+	}
+	return "ok " + statusName(GameStatus(slot->status));
+}
+
+bool GameServer::handleLine(Connection& connection, const string& line)
+{
+	stringstream stream(line);
+	string word;
+	stream >> word;
+	if (word.empty()) {
+		return true;
+	}
+	if (word == "quit") {
+		return false;
+	}
+
+	unsigned long long sequence = connection.nextSequence();
+	Request request = Request{ &connection, sequence, NewGame, NO_GAME, "" };
+
+	// not queued : a snapshot of the counters, the answer still comes after the earlier ones
+	if (word == "stats") {
+		connection.complete(sequence, getStats());
+		return true;
+	}
+
+	if (word == "new") {
+		getline(stream >> ws, request.argument);
+		request.game = pool.allocate();
+		if (request.game == NO_GAME) {
+			connection.complete(sequence, "error full");
+			return true;
+		}
+		dispatch(request);
+		return true;
+	}
+
+	if (word == "move") request.command = PlayMove;
+	else if (word == "moves") request.command = ListMoves;
+	else if (word == "fen") request.command = GetFEN;
+	else if (word == "status") request.command = GetStatus;
+	else if (word == "end") request.command = EndGame;
+	else {
+		connection.complete(sequence, "error unknown command");
+		return true;
+	}
+
+	if (!(stream >> request.game)) {
+		connection.complete(sequence, "error missing game");
+		return true;
+	}
+	stream >> request.argument;
+	dispatch(request);
+	return true;
+}
+
+void GameServer::serve(Connection& connection)
+{
+	string line;
+	while (connection.readLine(line) && handleLine(connection, line)) {
+	}
+	connection.waitForResponses();
+}
+
+unsigned long long GameServer::getRequestCount()
+{
+	unsigned long long count = 0;
+	for (unique_ptr<Worker>& worker : workers) {
+		count += worker->requests.load(memory_order_relaxed);
+	}
+	return count;
+}
+
+double GameServer::getLatencyPercentile(double percentile)
+{
+	unsigned long long total = getRequestCount();
+	if (!total) {
+		return 0.0;
+	}
+
+	unsigned long long rank = (unsigned long long)(percentile / 100.0 * double(total));
+	unsigned long long seen = 0;
+	for (int bucket = 0; bucket <= LATENCY_BUCKETS; bucket++) {
+		for (unique_ptr<Worker>& worker : workers) {
+			seen += worker->latencies[bucket].load(memory_order_relaxed);
+		}
+		if (seen > rank) {
+			// upper edge of the bucket
+			return double((bucket + 1) * LATENCY_BUCKET_NS) / 1000.0;
+		}
+	}
+	return double((LATENCY_BUCKETS + 1) * LATENCY_BUCKET_NS) / 1000.0;
+}
+
+string GameServer::getStats()
+{
+	stringstream stats;
+	stats << "ok games " << pool.getActiveGames() << " requests " << getRequestCount()
+		<< fixed << setprecision(1)
+		<< " p50 " << getLatencyPercentile(50.0) << "us"
+		<< " p99 " << getLatencyPercentile(99.0) << "us"
+		<< " p999 " << getLatencyPercentile(99.9) << "us";
+	return stats.str();
+}
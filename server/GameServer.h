@@ -0,0 +1,125 @@
+#pragma once
+
+#ifndef GAMESERVER_H
+#define GAMESERVER_H
+
+#include "Board.h"
+#include "GamePool.h"
+#include "GameLog.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <memory>
+
+// service time histogram, LATENCY_BUCKET_NS wide buckets, the last one holds everything slower
+#define LATENCY_BUCKETS 1000
+#define LATENCY_BUCKET_NS 100
+
+
+enum ConnectionKind {
+	StandardStreams,
+	SocketConnection,
+	// the responses are kept in memory, for a client living in the same process
+	CapturedConnection
+};
+
+// one client of the server, its responses are written in the order of its requests
+// even though the requests are handled by several workers
+class Connection {
+private:
+	ConnectionKind kind;
+	int socket;
+	string readBuffer;
+
+	std::mutex responsesMutex;
+	std::condition_variable responsesDone;
+	// responses waiting for the ones of earlier requests
+	map<unsigned long long, string> waitingResponses;
+	unsigned long long requestCount;
+	unsigned long long nextResponse;
+	vector<string> capturedResponses;
+
+	void write(const string& text);
+
+public:
+	Connection(ConnectionKind newKind, int newSocket = -1);
+
+	// false at the end of the input
+	bool readLine(string& line);
+	// only called by the thread reading the requests
+	unsigned long long nextSequence();
+	void complete(unsigned long long sequence, const string& response);
+	// blocks until every request got its response
+	void waitForResponses();
+	// for CapturedConnection
+	vector<string>& getCapturedResponses();
+};
+
+
+enum Command {
+	NewGame,
+	PlayMove,
+	ListMoves,
+	GetFEN,
+	GetStatus,
+	EndGame
+};
+
+typedef struct Request {
+	Connection* connection;
+	unsigned long long sequence;
+	Command command;
+	GameId game;
+	string argument;
+} Request;
+
+
+/*
+Hosts many games at once, see Server.cpp for the protocol.
+Every game belongs to one worker, picked from its slot index, and only that worker
+touches it : the requests of a game are handled in order and without locks.
+*/
+class GameServer {
+private:
+	struct Worker {
+		Board rules;
+		std::mutex queueMutex;
+		std::condition_variable queueNotEmpty;
+		std::deque<Request> queue;
+		std::thread thread;
+
+		std::atomic<unsigned long long> latencies[LATENCY_BUCKETS + 1];
+		std::atomic<unsigned long long> requests;
+
+		Worker();
+	};
+
+	GamePool pool;
+	// nullptr when the games are not logged
+	GameLogWriter* log;
+	vector<std::unique_ptr<Worker>> workers;
+	std::atomic<bool> stopped;
+
+	void work(Worker& worker);
+	string handle(Worker& worker, Request& request);
+	void dispatch(Request request);
+
+public:
+	GameServer(int threads, int capacity, GameLogWriter* newLog = nullptr);
+	~GameServer();
+
+	// false when the client asked to quit
+	bool handleLine(Connection& connection, const string& line);
+	// reads the requests of the connection until its end
+	void serve(Connection& connection);
+
+	unsigned long long getRequestCount();
+	// in microseconds, over every request handled so far
+	double getLatencyPercentile(double percentile);
+	// a snapshot, the requests still queued on the workers are not counted yet
+	string getStats();
+};
+
+#endif // !GAMESERVER_H
@@ -0,0 +1,221 @@
+#include "Board.h"
+#include "GameServer.h"
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*
+Headless server hosting many games in one process.
+
+It reads one request per line, on the standard input or from the clients of a
+Unix socket, and answers one line per request, in order :
+
+  new [fen]           -> ok <game>        starts a game, from the starting position by default
+  move <game> <move>  -> ok <status>      plays a move in coordinate notation (e2e4, e7e8q),
+                         illegal          status is ongoing, checkmate, stalemate, repetition or fiftymoves
+  moves <game>        -> ok <move> ...    the legal moves
+  fen <game>          -> ok <fen>
+  status <game>       -> ok <status>
+  end <game>          -> ok               frees the game
+  stats               -> ok games <n> requests <n> p50 <t>us p99 <t>us p999 <t>us
+  quit                                    closes the connection
+
+Errors are answered with "error <reason>".
+
+stats is answered right away by the thread reading the connection : it is a snapshot
+that doesn't wait for the requests sent before it to be handled by the workers, their
+answers are still given first.
+
+--log file appends every game to a game log (see GameLog.h), read it with the gamelog tool.
+
+--load N starts N games from a client inside the process, plays random games
+in all of them at once and reports the move latency.
+
+usage : server [--socket path] [--threads N] [--capacity N] [--log file] [--load games] [--plies N]
+*/
+
+
+// the moves of random games, played ahead of time so the load client only sends requests
+static vector<vector<Move>> playRandomGames(int games, int plies, int threads)
+{
+	vector<vector<Move>> moves(games);
+	vector<thread> players;
+	for (int t = 0; t < threads; t++) {
+		players.push_back(thread([&, t]() {
+			Board rules = Board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+			mt19937 random(t);
+			for (int game = t; game < games; game += threads) {
+				BoardState position = rules.getState();
+				PositionHistory history = PositionHistory{};
+				pushHistory(history, position.hash);
+				for (int ply = 0; ply < plies; ply++) {
+					// the server ends the game on a repetition or the 50 move rule as well
+					if (rules.getGameStatus(position, history) != Ongoing) {
+						break;
+					}
+					vector<Move> legalMoves = rules.getLegalMoves(position);
+					Move move = legalMoves[random() % legalMoves.size()];
+					moves[game].push_back(move);
+					position = rules.makeMove(move, position);
+					pushHistory(history, position.hash);
+				}
+			}
+		}));
+	}
+	for (thread& player : players) {
+		player.join();
+	}
+	return moves;
+}
+
+static int runLoad(GameServer& server, int games, int plies, int threads)
+{
+	cout << "playing " << plies << " random plies in " << games << " games" << endl;
+	vector<vector<Move>> moves = playRandomGames(games, plies, threads);
+
+	Connection client = Connection(CapturedConnection);
+	for (int game = 0; game < games; game++) {
+		server.handleLine(client, "new");
+	}
+	client.waitForResponses();
+
+	vector<string> ids;
+	for (const string& response : client.getCapturedResponses()) {
+		if (response.rfind("ok ", 0) != 0) {
+			cout << "could not start the games : " << response << endl;
+			return 1;
+		}
+		ids.push_back(response.substr(3));
+	}
+	client.getCapturedResponses().clear();
+
+	// one ply of every game at a time, like many players thinking at once
+	auto start = chrono::steady_clock::now();
+	unsigned long long sent = 0;
+	for (size_t ply = 0; ply < size_t(plies); ply++) {
+		for (int game = 0; game < games; game++) {
+			if (ply < moves[game].size()) {
+				server.handleLine(client, "move " + ids[game] + " " + moveToString(moves[game][ply]));
+				sent++;
+			}
+		}
+	}
+	client.waitForResponses();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	// the server has to agree with the rules used to make up the games
+	int refused = 0;
+	for (const string& response : client.getCapturedResponses()) {
+		if (response.rfind("ok", 0) != 0) {
+			refused++;
+		}
+	}
+
+	cout << sent << " moves in " << fixed << setprecision(2) << seconds << " s, "
+		<< setprecision(0) << double(sent) / seconds << " moves/s, " << refused << " refused" << endl;
+	cout << server.getStats() << endl;
+	return refused ? 1 : 0;
+}
+
+#ifndef _WIN32
+static int runSocket(GameServer& server, string path)
+{
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address = sockaddr_un{};
+	address.sun_family = AF_UNIX;
+	if (listener < 0 || path.size() >= sizeof(address.sun_path)) {
+		cout << "could not create the socket " << path << endl;
+		return 1;
+	}
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	unlink(path.c_str());
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 64) < 0) {
+		cout << "could not listen on " << path << endl;
+		return 1;
+	}
+	cout << "listening on " << path << endl;
+
+	while (true) {
+		int client = accept(listener, nullptr, nullptr);
+		if (client < 0) {
+			continue;
+		}
+		// reading a client is cheap, the requests themselves go to the workers
+		thread([&server, client]() {
+			Connection connection = Connection(SocketConnection, client);
+			server.serve(connection);
+			close(client);
+		}).detach();
+	}
+}
+#endif
+
+
+int main(int argc, char** argv)
+{
+	string socketPath = "";
+	int threads = max(1, int(thread::hardware_concurrency()));
+	int capacity = 16384;
+	int loadGames = 0;
+	int plies = 40;
+	string logPath = "";
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--socket" && hasValue) socketPath = argv[++i];
+		else if (arg == "--threads" && hasValue) threads = max(1, atoi(argv[++i]));
+		else if (arg == "--capacity" && hasValue) capacity = max(1, atoi(argv[++i]));
+		else if (arg == "--log" && hasValue) logPath = argv[++i];
+		else if (arg == "--load" && hasValue) loadGames = max(1, atoi(argv[++i]));
+		else if (arg == "--plies" && hasValue) plies = max(1, atoi(argv[++i]));
+		else {
+			cout << "usage : server [--socket path] [--threads N] [--capacity N] [--log file] [--load games] [--plies N]" << endl;
+			return 1;
+		}
+	}
+
+	unique_ptr<GameLogWriter> log;
+	if (!logPath.empty()) {
+		log = make_unique<GameLogWriter>(logPath);
+		if (!log->isOpen()) {
+			cout << "could not open the game log " << logPath << endl;
+			return 1;
+		}
+	}
+
+	GameServer server = GameServer(threads, max(capacity, loadGames), log.get());
+
+	if (loadGames) {
+		int status = runLoad(server, loadGames, plies, threads);
+		if (log) {
+			log->flush();
+		}
+		return status;
+	}
+
+	if (!socketPath.empty()) {
+#ifndef _WIN32
+		return runSocket(server, socketPath);
+#else
+		cout << "Unix sockets are not supported on this platform, use the standard input" << endl;
+		return 1;
+#endif
+	}
+
+	Connection connection = Connection(StandardStreams);
+	server.serve(connection);
+	return 0;
+}